@@ -0,0 +1,231 @@
+#include "AssemblerServer.h"
+#include "Bytes.h"
+#include "Images.h"
+#include "Parser.h"
+#include "Tokenizer.h"
+#include <File.hpp>
+#include <Printer.hpp>
+
+// Runs a request the way main() would run the same options, what it prints goes wherever tok's messages do.
+// Returns false where main() would give up, unresolved labels included since they can't be encoded.
+static bool run_assembly(Tokenizer& tok, uint32_t flags, Vector<uint32_t>& words, Vector<uint8_t>& data,
+                         bool& cacheable) {
+    ThreadPool serial{1};
+    if (auto res = tok.tokenize(); res.is_error()) {
+        tok.messages().print("Error tokenizing file: {}", res.to_error());
+        return false;
+    }
+    if (flags & AssembleRequest::dump_tokens) tok.dump_tokens();
+    Parser parser{tok};
+    parser.parse();
+    cacheable = !parser.includes_files();
+    if (flags & AssembleRequest::dump_labels) parser.dump_labels();
+    if (flags & AssembleRequest::want_data) {
+        if (parser.data_size() > SectionBuffer::max_size) {
+            tok.messages().print("Error dumping binary data because the data section is too big");
+            return false;
+        }
+        data.reserve(static_cast<size_t>(parser.data_size()));
+        parser.for_each_data_span([&data](const uint8_t* bytes, size_t size) { append_bytes(data, bytes, size); });
+    }
+    if (flags & AssembleRequest::dump_instructions) parser.dump_instructions();
+    if (!(flags & AssembleRequest::no_encode)) {
+        if (parser.has_unresolved_labels()) {
+            tok.messages().print("Error encoding instructions because some labels are not defined");
+            return false;
+        }
+        words = parser.encode(serial);
+    }
+    return true;
+}
+
+static void build_reply(Vector<uint8_t>& reply, ReplyStatus status, const String& output,
+                        const Vector<uint32_t>& words, const Vector<uint8_t>& data) {
+    AssembleReply header{};
+    header.status = status;
+    header.output_size = static_cast<uint32_t>(output.size());
+    header.code_words = words.size();
+    header.data_size = data.size();
+    reply.clear();
+    reply.reserve(sizeof(header) + output.size() + words.size() * sizeof(uint32_t) + data.size());
+    append_bytes(reply, &header, sizeof(header));
+    append_bytes(reply, output.data(), output.size());
+    append_bytes(reply, words.data(), words.size() * sizeof(uint32_t));
+    append_bytes(reply, data.data(), data.size());
+}
+
+static void failure_reply(Vector<uint8_t>& reply, const String& message) {
+    build_reply(reply, ReplyStatus::Failed, message, Vector<uint32_t>{}, Vector<uint8_t>{});
+}
+
+void AssemblerServer::serve() {
+    auto handler = [this](const Vector<uint8_t>& request, Vector<uint8_t>& reply) { handle(request, reply); };
+    m_server.serve(handler);
+}
+
+bool AssemblerServer::find_cached(uint64_t hash, const Vector<uint8_t>& key, Vector<uint8_t>& reply) {
+    LockGuard guard{m_lock};
+    for (const auto& entry : m_cache) {
+        if (entry.hash != hash || entry.key.size() != key.size()) continue;
+        if (key.size() > 0 && ARLib::memcmp(entry.key.data(), key.data(), key.size()) != 0) continue;
+        reply.resize(entry.reply.size());
+        ARLib::memcpy(reply.data(), entry.reply.data(), entry.reply.size());
+        return true;
+    }
+    return false;
+}
+
+// the oldest replies make room for new ones, a reply too big for the whole cache isn't kept
+void AssemblerServer::add_cached(uint64_t hash, Vector<uint8_t> key, const Vector<uint8_t>& reply) {
+    const size_t size = key.size() + reply.size();
+    if (size > max_cache_bytes) return;
+    Vector<uint8_t> copy{};
+    append_bytes(copy, reply.data(), reply.size());
+    LockGuard guard{m_lock};
+    size_t evicted = 0;
+    while (evicted < m_cache.size() && m_cache_bytes + size > max_cache_bytes) {
+        m_cache_bytes -= m_cache[evicted].key.size() + m_cache[evicted].reply.size();
+        ++evicted;
+    }
+    if (evicted > 0) {
+        Vector<CachedReply> kept{};
+        kept.reserve(m_cache.size() - evicted + 1);
+        for (size_t i = evicted; i < m_cache.size(); ++i) {
+            kept.append(move(m_cache[i]));
+        }
+        m_cache = move(kept);
+    }
+    m_cache.append(CachedReply{hash, move(key), move(copy)});
+    m_cache_bytes += size;
+}
+
+void AssemblerServer::handle(const Vector<uint8_t>& request, Vector<uint8_t>& reply) {
+    AssembleRequest header{};
+    if (request.size() < sizeof(header)) {
+        failure_reply(reply, "malformed request\n"_s);
+        return;
+    }
+    ARLib::memcpy(&header, request.data(), sizeof(header));
+    const size_t payload = static_cast<size_t>(header.path_size) + header.source_size;
+    if (header.magic != AssembleRequest::magic_value || request.size() - sizeof(header) != payload) {
+        failure_reply(reply, "malformed request\n"_s);
+        return;
+    }
+    if (header.flags & AssembleRequest::stop_server) {
+        build_reply(reply, ReplyStatus::Ok, String{}, Vector<uint32_t>{}, Vector<uint8_t>{});
+        m_server.stop();
+        return;
+    }
+    const char* payload_data = reinterpret_cast<const char*>(request.data() + sizeof(header));
+    const StringView path{payload_data, payload_data + header.path_size};
+    const StringView inline_source{payload_data + header.path_size, payload_data + payload};
+
+    Tokenizer tok{Path{String{path}}};
+    String output{};
+    tok.messages().capture_into(&output);
+    if (header.flags & AssembleRequest::source_is_path) {
+        if (auto res = tok.open(); res.is_error()) {
+            tok.messages().print("Error opening file: {}", res.to_error());
+            failure_reply(reply, output);
+            return;
+        }
+    } else {
+        tok.load(String{inline_source});
+    }
+
+    // the key is everything the reply depends on: the options, the name diagnostics use and the source itself
+    const StringView source = tok.source_text();
+    const uint32_t key_flags = header.flags & ~AssembleRequest::source_is_path;
+    Vector<uint8_t> key{};
+    key.reserve(sizeof(key_flags) + sizeof(header.path_size) + path.size() + source.size());
+    append_bytes(key, &key_flags, sizeof(key_flags));
+    append_bytes(key, &header.path_size, sizeof(header.path_size));
+    append_bytes(key, path.data(), path.size());
+    append_bytes(key, source.data(), source.size());
+    const uint64_t hash = content_hash(key);
+    if (find_cached(hash, key, reply)) {
+        AssembleReply cached{};
+        ARLib::memcpy(&cached, reply.data(), sizeof(cached));
+        cached.cached = 1;
+        ARLib::memcpy(reply.data(), &cached, sizeof(cached));
+        return;
+    }
+
+    Vector<uint32_t> words{};
+    Vector<uint8_t> data{};
+    bool cacheable = false;
+    const bool ok = run_assembly(tok, header.flags, words, data, cacheable);
+    build_reply(reply, ok ? ReplyStatus::Ok : ReplyStatus::Failed, output, words, data);
+    if (cacheable) add_cached(hash, move(key), reply);
+}
+
+bool assemble_remotely(StringView socket_path, const String& file, const ThreadPool& pool,
+                       const ClientOptions& options) {
+    AssembleRequest header{};
+    if (options.send_path) header.flags |= AssembleRequest::source_is_path;
+    if (options.rodata) header.flags |= AssembleRequest::want_data;
+    if (options.dump_tokens) header.flags |= AssembleRequest::dump_tokens;
+    if (options.dump_labels) header.flags |= AssembleRequest::dump_labels;
+    if (options.dump_instructions) header.flags |= AssembleRequest::dump_instructions;
+    if (options.no_encode) header.flags |= AssembleRequest::no_encode;
+    String source{};
+    if (!options.send_path) {
+        File input{Path{file}};
+        if (auto res = input.open(OpenFileMode::Read); res.is_error()) {
+            Printer::print("Error opening file: {}", res.to_error());
+            return false;
+        }
+        auto contents_or_err = input.read_all();
+        if (contents_or_err.is_error()) {
+            Printer::print("Error opening file: {}", contents_or_err.to_error());
+            return false;
+        }
+        source = contents_or_err.to_ok();
+    }
+    if (file.size() + source.size() > LocalSocket::max_message_size) {
+        Printer::print("Error opening file: it's too big to be sent to the server");
+        return false;
+    }
+    header.path_size = static_cast<uint32_t>(file.size());
+    header.source_size = static_cast<uint32_t>(source.size());
+    Vector<uint8_t> request{};
+    append_bytes(request, &header, sizeof(header));
+    append_bytes(request, file.data(), file.size());
+    append_bytes(request, source.data(), source.size());
+
+    Vector<uint8_t> reply{};
+    AssembleReply reply_header{};
+    if (!round_trip(socket_path, request, reply, reply_header)) return false;
+    const uint8_t* payload = reply.data() + sizeof(reply_header);
+    print_server_output(StringView{reinterpret_cast<const char*>(payload), reply_header.output_size});
+    if (reply_header.status != ReplyStatus::Ok) return false;
+    payload += reply_header.output_size;
+    Vector<uint32_t> words{};
+    words.resize(static_cast<size_t>(reply_header.code_words));
+    if (!words.empty()) ARLib::memcpy(words.data(), payload, words.size() * sizeof(uint32_t));
+    payload += words.size() * sizeof(uint32_t);
+    const Path source_path{file};
+    if (options.rodata) {
+        const OutputSpan span{payload, static_cast<size_t>(reply_header.data_size)};
+        if (!write_data_image(source_path, &span, 1)) {
+            Printer::print("Error dumping binary data because {}", last_error());
+            return false;
+        }
+    }
+    if (!options.no_encode && !write_code_image(source_path, pool, words.data(), words.size(), options.binary)) {
+        Printer::print("Error writing encoded instructions because {}", last_error());
+        return false;
+    }
+    Printer::print("File {} finished assembling successfully", file);
+    return true;
+}
+
+bool stop_server(StringView socket_path) {
+    AssembleRequest header{};
+    header.flags = AssembleRequest::stop_server;
+    Vector<uint8_t> request{};
+    append_bytes(request, &header, sizeof(header));
+    Vector<uint8_t> reply{};
+    AssembleReply reply_header{};
+    return round_trip(socket_path, request, reply, reply_header) && reply_header.status == ReplyStatus::Ok;
+}
\ No newline at end of file
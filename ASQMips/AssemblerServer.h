@@ -0,0 +1,79 @@
+#pragma once
+#include "LocalServer.h"
+#include <String.hpp>
+#include <StringView.hpp>
+#include <Vector.hpp>
+
+using namespace ARLib;
+
+// Requests and replies exchanged with the assembler server, each one is a single LocalSocket message. Request:
+// the header, then path_size bytes of path and source_size bytes of source. Reply: the header, then output_size
+// bytes of diagnostics and dumps, code_words encoded instructions and data_size bytes of data section.
+struct AssembleRequest {
+    constexpr static uint32_t magic_value = 0x52515341; // "ASQR"
+    // the server reads the source from the path itself, relative to its own working directory
+    constexpr static uint32_t source_is_path = 1u << 0;
+    constexpr static uint32_t want_data = 1u << 1;
+    constexpr static uint32_t dump_tokens = 1u << 2;
+    constexpr static uint32_t dump_labels = 1u << 3;
+    constexpr static uint32_t dump_instructions = 1u << 4;
+    constexpr static uint32_t no_encode = 1u << 5;
+    constexpr static uint32_t stop_server = 1u << 6;
+    uint32_t magic = magic_value;
+    uint32_t flags = 0;
+    uint32_t path_size = 0;
+    uint32_t source_size = 0;
+};
+
+enum class ReplyStatus : uint32_t { Ok, Failed };
+
+struct AssembleReply {
+    constexpr static uint32_t magic_value = 0x41515341; // "ASQA"
+    uint32_t magic = magic_value;
+    ReplyStatus status = ReplyStatus::Failed;
+    // the reply was served from the cache
+    uint32_t cached = 0;
+    uint32_t output_size = 0;
+    uint64_t code_words = 0;
+    uint64_t data_size = 0;
+    uint64_t payload_size() const { return output_size + code_words * sizeof(uint32_t) + data_size; }
+};
+
+// Long-running assembler that serves requests from local clients through a LocalServer, so they don't pay for
+// process startup. Replies are cached keyed by the request and the content of the source.
+class AssemblerServer {
+    struct CachedReply {
+        uint64_t hash;
+        Vector<uint8_t> key;
+        Vector<uint8_t> reply;
+    };
+    constexpr static size_t max_cache_bytes = 256 * 1024 * 1024;
+    LocalServer m_server;
+    Mutex m_lock{};
+    // guarded by m_lock, oldest entries first
+    Vector<CachedReply> m_cache{};
+    size_t m_cache_bytes = 0;
+    void handle(const Vector<uint8_t>& request, Vector<uint8_t>& reply);
+    bool find_cached(uint64_t hash, const Vector<uint8_t>& key, Vector<uint8_t>& reply);
+    void add_cached(uint64_t hash, Vector<uint8_t> key, const Vector<uint8_t>& reply);
+
+    public:
+    explicit AssemblerServer(const ThreadPool& pool) : m_server(pool) {}
+    DiscardResult<FileError> listen(StringView socket_path) { return m_server.listen(socket_path); }
+    // serves clients until one of them asks the server to stop
+    void serve();
+};
+
+struct ClientOptions {
+    bool rodata = false;
+    bool dump_tokens = false;
+    bool dump_labels = false;
+    bool dump_instructions = false;
+    bool no_encode = false;
+    bool binary = false;
+    bool send_path = false;
+};
+
+// Has the server assemble the file and writes the same outputs a local run would, false on failure.
+bool assemble_remotely(StringView socket_path, const String& file, const ThreadPool& pool, const ClientOptions& options);
+bool stop_server(StringView socket_path);
\ No newline at end of file
@@ -0,0 +1,470 @@
+#pragma once
+#include "DirectiveParser.h"
+#include "InstructionParser.h"
+#include "NumberParser.h"
+#include "Scanner.h"
+#include <Array.hpp>
+#include <StringView.hpp>
+#include <Types.hpp>
+
+using namespace ARLib;
+
+// String literal that can be passed as a template argument, see assemble_constexpr.
+template <size_t N>
+struct SourceLiteral {
+    char text[N]{};
+    constexpr SourceLiteral(const char (&literal)[N]) {
+        for (size_t i = 0; i < N; ++i)
+            text[i] = literal[i];
+    }
+    constexpr StringView view() const { return StringView{text, N - 1}; }
+};
+
+// Encoded words and initial data memory of a program assembled at compile time. The arrays are never empty so a
+// program without data still has one, only the first code_size words and data_size bytes belong to the program.
+template <size_t Words, size_t DataBytes>
+struct ConstexprProgram {
+    constexpr static size_t code_size = Words;
+    constexpr static size_t data_size = DataBytes;
+    Array<uint32_t, (Words > 0 ? Words : 1)> code{};
+    Array<uint8_t, (DataBytes > 0 ? DataBytes : 1)> data{};
+};
+
+namespace CompileTimeAssembly {
+    // Deliberately not constexpr: reaching it while assembling at compile time fails the constant evaluation and the
+    // compiler points at the call with its message.
+    inline void error(const char*) {}
+
+    // Same tokens as the Tokenizer, produced one at a time. Labels come with their colon already consumed.
+    class Lexer {
+        struct Lexeme {
+            TokenKind kind = TokenKind::Invalid;
+            StringView text{};
+        };
+        const char* m_next_line;
+        const char* const m_end;
+        const char* m_it = nullptr;
+        const char* m_line_end = nullptr;
+        TokenKind m_previous = TokenKind::Invalid;
+        Lexeme m_raw_ahead{};
+        bool m_has_raw_ahead = false;
+        Lexeme m_ahead{};
+        bool m_has_ahead = false;
+
+        // moves to the next line with something before its comment, false at the end of the source
+        constexpr bool next_line() {
+            while (m_next_line != m_end) {
+                const char* begin = m_next_line;
+                const char* it = begin;
+                while (it != m_end && *it != '\n' && *it != ';')
+                    ++it;
+                const char* end = it;
+                while (it != m_end && *it != '\n')
+                    ++it;
+                m_next_line = it == m_end ? it : it + 1;
+                while (begin != end && has_class(*begin, CharClass::Space))
+                    ++begin;
+                while (end != begin && has_class(*(end - 1), CharClass::Space))
+                    --end;
+                if (begin == end) continue;
+                m_it = begin;
+                m_line_end = end;
+                return true;
+            }
+            return false;
+        }
+        constexpr const char* find_in_line(const char* it, char c) const {
+            while (it != m_line_end && *it != c)
+                ++it;
+            return it;
+        }
+        constexpr Lexeme scan() {
+            while (true) {
+                while (m_it != m_line_end && has_class(*m_it, CharClass::Space))
+                    ++m_it;
+                if (m_it != m_line_end) break;
+                if (!next_line()) return Lexeme{};
+            }
+            const char* const begin = m_it;
+            if (auto kind = separator_kind(*begin); kind != TokenKind::Invalid) {
+                if (kind == TokenKind::Quote) {
+                    const char* quote = find_in_line(begin + 1, '"');
+                    if (quote == m_line_end) error("unterminated string");
+                    m_it = quote + 1;
+                    return Lexeme{TokenKind::String, StringView{begin + 1, quote}};
+                }
+                if (kind == TokenKind::Apostrophe) {
+                    const char* apostrophe = find_in_line(begin + 1, '\'');
+                    if (apostrophe == m_line_end || apostrophe - begin != 2) error("unterminated character literal");
+                    m_it = apostrophe + 1;
+                    return Lexeme{TokenKind::Char, StringView{begin + 1, apostrophe}};
+                }
+                ++m_it;
+                return Lexeme{kind, StringView{begin, m_it}};
+            }
+            if (has_class(*begin, CharClass::Number) && *begin != '.') {
+                size_t dots = 0;
+                while (m_it != m_line_end && has_class(*m_it, CharClass::Number)) {
+                    if (*m_it == '.' && ++dots > 1) error("unexpected second decimal divider in a number");
+                    ++m_it;
+                }
+                if (*begin == '-' && m_it == begin + 1) error("lone - found");
+                return Lexeme{dots == 0 ? TokenKind::Integer : TokenKind::Real, StringView{begin, m_it}};
+            }
+            if (has_class(*begin, CharClass::Ident)) {
+                while (m_it != m_line_end && has_class(*m_it, CharClass::Ident))
+                    ++m_it;
+                const StringView word{begin, m_it};
+                if (m_previous == TokenKind::Dot && is_directive(word) != nullptr) {
+                    return Lexeme{TokenKind::Directive, word};
+                }
+                return Lexeme{TokenKind::Identifier, word};
+            }
+            error("invalid identifier token");
+            return Lexeme{};
+        }
+        constexpr Lexeme raw_next() {
+            if (m_has_raw_ahead) {
+                m_has_raw_ahead = false;
+                return m_raw_ahead;
+            }
+            const Lexeme lexeme = scan();
+            m_previous = lexeme.kind;
+            return lexeme;
+        }
+        constexpr const Lexeme& raw_peek() {
+            if (!m_has_raw_ahead) {
+                m_raw_ahead = raw_next();
+                m_has_raw_ahead = true;
+            }
+            return m_raw_ahead;
+        }
+        constexpr Lexeme read() {
+            Lexeme lexeme = raw_next();
+            if (lexeme.kind == TokenKind::Identifier && raw_peek().kind == TokenKind::Colon) {
+                raw_next();
+                lexeme.kind = TokenKind::Label;
+            } else if (lexeme.kind == TokenKind::Colon) {
+                error("unexpected colon after token");
+            }
+            return lexeme;
+        }
+
+        public:
+        constexpr explicit Lexer(StringView source) :
+            m_next_line(source.data()), m_end(source.data() + source.size()) {}
+        // TokenKind::Invalid at the end of the source
+        constexpr Lexeme next() {
+            if (m_has_ahead) {
+                m_has_ahead = false;
+                return m_ahead;
+            }
+            return read();
+        }
+        constexpr const Lexeme& peek() {
+            if (!m_has_ahead) {
+                m_ahead = read();
+                m_has_ahead = true;
+            }
+            return m_ahead;
+        }
+        constexpr bool done() { return peek().kind == TokenKind::Invalid; }
+    };
+
+    enum class Section { None, Data, Text };
+
+    constexpr uint64_t align_address(uint64_t val, uint64_t off, uint64_t align = sizeof(uint64_t)) {
+        uint64_t newval = val + off;
+        if (newval < align) return align;
+        if (uint64_t disp = newval % align; disp != 0) { newval += (align - disp); }
+        return newval;
+    }
+
+    constexpr uint64_t unsigned_value(StringView text) {
+        uint64_t value = 0;
+        if (text[0] == '-' || !parse_decimal_magnitude(text, value)) error("expected an unsigned number");
+        return value;
+    }
+
+    constexpr int32_t integer_immediate(StringView text) {
+        uint64_t magnitude = 0;
+        if (!parse_decimal_magnitude(text, magnitude)) error("integer immediate is too long");
+        return static_cast<int32_t>(text[0] == '-' ? 0 - magnitude : magnitude);
+    }
+
+    constexpr void expect(Lexer& lexer, TokenKind kind) {
+        if (lexer.next().kind != kind) error("unexpected token");
+    }
+
+    template <typename Sink>
+    constexpr void write_value(Sink& sink, uint64_t address, uint64_t bits, size_t value_size) {
+        for (size_t i = 0; i < value_size; ++i)
+            sink.write(address + i, static_cast<uint8_t>(bits >> (i * 8)));
+    }
+
+    // Walks the source the way Parser::parse_statements does and hands labels, encoded words and data bytes to the
+    // sink. Whatever the runtime assembler would read from disk or only handles with its slow fallbacks (.incbin,
+    // integers over 19 digits, reals that parse_simple_double rejects, real immediates) is an error here.
+    template <typename Sink>
+    constexpr void walk(StringView source, Sink& sink) {
+        Lexer lexer{source};
+        Section section = Section::None;
+        uint64_t current_address = 0;
+        uint32_t current_pc = 0;
+        auto section_change = [&](StringView name) {
+            if (name == "data"_sv) {
+                section = Section::Data;
+            } else if (name == "text"_sv || name == "code"_sv) {
+                section = Section::Text;
+            } else {
+                error("expected .data, .text or .code");
+            }
+        };
+        auto value_list = [&](size_t value_size) {
+            while (lexer.peek().kind == TokenKind::Integer || lexer.peek().kind == TokenKind::Real) {
+                const auto tok = lexer.next();
+                if (tok.kind == TokenKind::Integer) {
+                    uint64_t magnitude = 0;
+                    if (!parse_decimal_magnitude(tok.text, magnitude)) error("integer literal is too long");
+                    write_value(sink, current_address, magnitude, value_size);
+                } else {
+                    double value = 0;
+                    if (!parse_simple_double(tok.text, value)) error("real literal is too precise");
+                    write_value(sink, current_address, BitCast<uint64_t>(value), value_size);
+                }
+                current_address += value_size;
+                if (lexer.peek().kind != TokenKind::Comma) break;
+                lexer.next();
+            }
+            current_address = align_address(current_address, 0);
+        };
+        auto directive = [&](StringView name) {
+            const auto* dir = directive_map.find(name);
+            switch (dir->val) {
+            case DirectiveType::data:
+            case DirectiveType::text:
+            case DirectiveType::code:
+                section_change(name);
+                break;
+            case DirectiveType::org: {
+                const auto value = lexer.next();
+                if (value.kind != TokenKind::Integer) error("expected an integer");
+                current_address = unsigned_value(value.text);
+            } break;
+            case DirectiveType::align: {
+                const auto value = lexer.next();
+                if (value.kind != TokenKind::Integer) error("expected an integer");
+                current_address = align_address(current_address, 0, unsigned_value(value.text));
+            } break;
+            case DirectiveType::space: {
+                const auto value = lexer.next();
+                if (value.kind != TokenKind::Integer) error("expected an integer");
+                current_address = align_address(current_address, unsigned_value(value.text));
+            } break;
+            case DirectiveType::ascii:
+            case DirectiveType::asciiz: {
+                const auto str = lexer.next();
+                if (str.kind != TokenKind::String) error("expected a string");
+                for (size_t i = 0; i < str.text.size(); ++i)
+                    sink.write(current_address + i, static_cast<uint8_t>(str.text[i]));
+                size_t length = str.text.size();
+                if (dir->val == DirectiveType::asciiz) sink.write(current_address + length++, 0);
+                current_address = align_address(current_address, length);
+            } break;
+            case DirectiveType::incbin:
+                error(".incbin can't be assembled at compile time");
+                break;
+            case DirectiveType::byte:
+                value_list(sizeof(uint8_t));
+                break;
+            case DirectiveType::word:
+                value_list(sizeof(uint64_t));
+                break;
+            case DirectiveType::word32:
+                value_list(sizeof(uint32_t));
+                break;
+            case DirectiveType::word16:
+                value_list(sizeof(uint16_t));
+                break;
+            case DirectiveType::double_:
+                value_list(sizeof(double));
+                break;
+            }
+        };
+        auto reg = [&]() {
+            const auto tok = lexer.next();
+            if (tok.kind != TokenKind::Identifier) error("expected a register");
+            const auto* found = register_map.find(tok.text);
+            if (found == nullptr) {
+                error("register not found in register map");
+                return RegisterEnum::r0;
+            }
+            return found->val;
+        };
+        auto immediate = [&]() -> int32_t {
+            const auto tok = lexer.next();
+            if (tok.kind == TokenKind::Integer) return integer_immediate(tok.text);
+            if (tok.kind == TokenKind::Identifier) return static_cast<int32_t>(sink.resolve(tok.text));
+            error("only integers and labels can be immediates at compile time");
+            return 0;
+        };
+        auto instruction = [&](StringView name) {
+            Array<StringView, 3> pieces{name};
+            size_t piece_count = 1;
+            while (piece_count < pieces.size() && lexer.peek().kind == TokenKind::Dot) {
+                lexer.next();
+                const auto piece = lexer.next();
+                if (piece.kind != TokenKind::Identifier) error("unexpected token in instruction name");
+                pieces[piece_count++] = piece.text;
+            }
+            const auto* inst = instruction_map.find(pieces.data(), piece_count);
+            if (inst == nullptr) {
+                error("invalid instruction");
+                return;
+            }
+            Array<RegisterEnum, 3> regs{};
+            int32_t imm = 0;
+            for (size_t i = 0; i < inst->arg_count; ++i) {
+                switch (inst->arg_types[i]) {
+                case ArgumentType::Imm:
+                    imm = immediate();
+                    break;
+                case ArgumentType::Freg:
+                    regs[i] = reg();
+                    if (regs[i] < RegisterEnum::f0) error("register is not a floating point register");
+                    break;
+                case ArgumentType::Reg:
+                    regs[i] = reg();
+                    if (regs[i] > RegisterEnum::r31) error("register is not an integer register");
+                    break;
+                case ArgumentType::ImmWReg:
+                    imm = immediate();
+                    expect(lexer, TokenKind::OpenParens);
+                    regs[i] = reg();
+                    expect(lexer, TokenKind::CloseParens);
+                    break;
+                }
+                if (i != inst->arg_count - 1) expect(lexer, TokenKind::Comma);
+            }
+            sink.instruction(encode_instruction(inst->insn, regs, imm, current_pc));
+            current_pc += sizeof(uint32_t);
+        };
+        while (!lexer.done()) {
+            const auto tok = lexer.next();
+            switch (section) {
+            case Section::None: {
+                if (tok.kind != TokenKind::Dot) error("expected .data, .text or .code");
+                const auto name = lexer.next();
+                if (name.kind != TokenKind::Directive) error("expected .data, .text or .code");
+                section_change(name.text);
+            } break;
+            case Section::Data:
+                if (tok.kind == TokenKind::Label) {
+                    sink.label(tok.text, current_address);
+                } else if (tok.kind == TokenKind::Dot) {
+                    const auto name = lexer.next();
+                    if (name.kind != TokenKind::Directive) error("expected a directive");
+                    directive(name.text);
+                } else {
+                    error("invalid token in data section");
+                }
+                break;
+            case Section::Text:
+                if (tok.kind == TokenKind::Identifier) {
+                    instruction(tok.text);
+                } else if (tok.kind == TokenKind::Label) {
+                    sink.label(tok.text, current_pc);
+                } else if (tok.kind == TokenKind::Dot) {
+                    // like the runtime assembler, .org in the text section moves the data address
+                    const auto name = lexer.next();
+                    if (name.kind != TokenKind::Directive) error("expected a directive");
+                    const auto type = directive_map.find(name.text)->val;
+                    if (type != DirectiveType::data && type != DirectiveType::text && type != DirectiveType::code &&
+                        type != DirectiveType::org) {
+                        error("invalid directive in text section");
+                    }
+                    directive(name.text);
+                } else {
+                    error("unhandled token");
+                }
+                break;
+            }
+        }
+        sink.finish(current_address);
+    }
+
+    struct Layout {
+        size_t words = 0;
+        size_t labels = 0;
+        uint64_t data_size = 0;
+        constexpr void label(StringView, uint64_t) { ++labels; }
+        constexpr uint64_t resolve(StringView) const { return 0; }
+        constexpr void instruction(uint32_t) { ++words; }
+        constexpr void write(uint64_t, uint8_t) {}
+        constexpr void finish(uint64_t data_end) { data_size = data_end; }
+    };
+
+    template <size_t Count>
+    struct Labels {
+        Array<Label, (Count > 0 ? Count : 1)> entries{};
+        size_t count = 0;
+        constexpr const Label* find(StringView name) const {
+            for (size_t i = 0; i < count; ++i) {
+                if (entries[i].name == name) return &entries[i];
+            }
+            return nullptr;
+        }
+        constexpr void label(StringView name, uint64_t address) {
+            if (find(name) != nullptr) error("duplicate label");
+            entries[count++] = Label{name, static_cast<size_t>(address)};
+        }
+        constexpr uint64_t resolve(StringView) const { return 0; }
+        constexpr void instruction(uint32_t) {}
+        constexpr void write(uint64_t, uint8_t) {}
+        constexpr void finish(uint64_t) {}
+    };
+
+    template <size_t Count, size_t Words, size_t DataBytes>
+    struct Emitter {
+        const Labels<Count>& labels;
+        ConstexprProgram<Words, DataBytes>& program;
+        size_t next_word = 0;
+        constexpr void label(StringView, uint64_t) {}
+        constexpr uint64_t resolve(StringView name) const {
+            const Label* label = labels.find(name);
+            if (label == nullptr) {
+                error("undefined label");
+                return 0;
+            }
+            return label->address;
+        }
+        constexpr void instruction(uint32_t word) { program.code[next_word++] = word; }
+        // like the data image the runtime assembler writes, only what's below the final data address is kept
+        constexpr void write(uint64_t address, uint8_t value) {
+            if (address < DataBytes) program.data[static_cast<size_t>(address)] = value;
+        }
+        constexpr void finish(uint64_t) {}
+    };
+
+    template <typename Sink>
+    constexpr Sink run(StringView source, Sink sink) {
+        walk(source, sink);
+        return sink;
+    }
+} // namespace CompileTimeAssembly
+
+// Assembles Source while compiling: the words are the ones the assembler writes to the .cod file and the data is the
+// initial memory image, ready for InstructionData::load_words and BinaryData::load_image. Anything the assembler
+// would report makes the call fail to compile.
+//     constexpr auto program = assemble_constexpr<".text\ndaddi r1, r0, 5\nhalt">();
+template <SourceLiteral Source>
+consteval auto assemble_constexpr() {
+    using namespace CompileTimeAssembly;
+    constexpr auto layout = run(Source.view(), Layout{});
+    constexpr auto labels = run(Source.view(), Labels<layout.labels>{});
+    constexpr auto data_size = static_cast<size_t>(layout.data_size);
+    ConstexprProgram<layout.words, data_size> program{};
+    Emitter<layout.labels, layout.words, data_size> emitter{labels, program};
+    walk(Source.view(), emitter);
+    return program;
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include "ConstexprAssembler.h"
+
+// Compiled only for these checks: the compile-time assembler shares the encoder and the number parser with the
+// runtime one, so a change to either that makes them disagree fails the build here. The expected words and bytes are
+// the .cod and .bin the runtime assembler writes for the same sources.
+
+constexpr auto single_instruction = assemble_constexpr<".text\ndaddi r1, r0, 5\nhalt">();
+static_assert(single_instruction.code_size == 2);
+static_assert(single_instruction.code[0] == 0x60010005);
+static_assert(single_instruction.code[1] == 0x04000000);
+static_assert(single_instruction.data_size == 0);
+
+// .data words, loads through label offsets and a loop closed by a backward branch
+constexpr auto counted_loop = assemble_constexpr<R"(.data
+values: .word 7, 2
+count: .word 3
+.text
+ld r4, count(r0)
+ld r5, values(r2)
+daddi r1, r0, 0
+loop:
+daddi r1, r1, 1
+dsub r2, r4, r1
+bnez r2, loop
+halt
+)">();
+static_assert(counted_loop.code_size == 7);
+static_assert(counted_loop.code[0] == 0xdc040010);
+static_assert(counted_loop.code[1] == 0xdc450000);
+static_assert(counted_loop.code[2] == 0x60010000);
+static_assert(counted_loop.code[3] == 0x60210001);
+static_assert(counted_loop.code[4] == 0x0081102e);
+static_assert(counted_loop.code[5] == 0x1c02fffd);
+static_assert(counted_loop.code[6] == 0x04000000);
+static_assert(counted_loop.data_size == 24);
+static_assert(counted_loop.data[0] == 7 && counted_loop.data[8] == 2 && counted_loop.data[16] == 3);
\ No newline at end of file
@@ -1,12 +1,12 @@
 #pragma once
+#include "PerfectHash.h"
 #include "Tokenizer.h"
-#include <CxprHashMap.hpp>
 #include <EnumHelpers.hpp>
 
 using namespace ARLib;
 
 MAKE_FANCY_ENUM(DirectiveType, uint8_t, data, text, code, org, space, asciiz, ascii, align, word, byte, word32, word16,
-                double_)
+                double_, incbin)
 
 struct Directive {
     StringView name;
@@ -14,29 +14,27 @@ struct Directive {
     constexpr bool operator==(const Directive& other) const { return name == other.name && val == other.val; }
 };
 
-template <>
-struct cxpr::Hasher<Directive> {
-    constexpr uint32_t operator()(const Directive& val) const noexcept { return crc32::calculate(val.name); }
-};
-
 constexpr auto construct_directive_map() {
-    cxpr::HashTable<Directive, enum_size<DirectiveType>()> table{};
+    Array<Directive, enum_size<DirectiveType>()> entries{};
     for (auto e : for_each_enum<DirectiveType>()) {
         const auto view = enum_to_str_view(e);
+        auto& entry = entries[static_cast<size_t>(ToUnderlying(e))];
         if (view[view.size() - 1] == '_') {
-            table.insert({view.substringview(0, view.size() - 1), e});
+            entry = Directive{view.substringview(0, view.size() - 1), e};
         } else {
-            table.insert({view, e});
+            entry = Directive{view, e};
         }
     }
-    return table;
+    return PerfectHashTable<Directive, enum_size<DirectiveType>(), 64>{entries};
 }
 
 constexpr auto directive_map = construct_directive_map();
+static_assert(directive_map.is_valid(), "no perfect hash seed found for the directives");
 
-constexpr auto is_directive(const StringView word) {
-    return directive_map.find(word, [](const Directive& v, const StringView view) { return v.name == view; });
+// nullptr if word is not a directive
+constexpr const Directive* is_directive(const StringView word) {
+    return directive_map.find(word);
 }
 
 class Parser;
-tit parse_directive(tit begin, tit end, Parser& parser);
+tit parse_directive(tit begin, tit end, Parser& parser);
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include "FileWatcher.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__linux__)
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// how long to wait for an editor to finish writing once a change was seen
+constexpr int settle_ms = 50;
+
+#ifdef _WIN32
+DiscardResult<FileError> FileWatcher::watch(const Path& path) {
+    stop();
+    const auto& full = path.string();
+    size_t cut = full.size();
+    while (cut > 0 && full[cut - 1] != L'/' && full[cut - 1] != L'\\')
+        --cut;
+    wchar_t dir[MAX_PATH]{L'.'};
+    if (cut >= MAX_PATH) { return FileError{"Path is too long to watch"_s}; }
+    for (size_t i = 0; i < cut; ++i) {
+        dir[i] = full[i];
+    }
+    if (cut > 0) dir[cut] = L'\0';
+    HANDLE handle =
+    FindFirstChangeNotificationW(dir, FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+    if (handle == INVALID_HANDLE_VALUE) { return FileError{"Failed to watch the directory of the file"_s}; }
+    m_handle = handle;
+    return {};
+}
+
+// directory notifications can't be filtered by name, changes to other files just cause an unchanged re-read
+bool FileWatcher::wait() {
+    if (m_handle == nullptr) return false;
+    if (WaitForSingleObject(m_handle, INFINITE) != WAIT_OBJECT_0) return false;
+    Sleep(settle_ms);
+    return FindNextChangeNotification(m_handle) != 0;
+}
+
+void FileWatcher::stop() {
+    if (m_handle) FindCloseChangeNotification(m_handle);
+    m_handle = nullptr;
+}
+#elif defined(__linux__)
+DiscardResult<FileError> FileWatcher::watch(const Path& path) {
+    stop();
+    const StringView full = path.string().view();
+    size_t cut = full.size();
+    while (cut > 0 && full[cut - 1] != '/')
+        --cut;
+    const String dir = cut == 0 ? "."_s : String{full.substringview(0, cut)};
+    m_name = String{full.substringview(cut)};
+    m_fd = inotify_init1(IN_CLOEXEC);
+    if (m_fd < 0) { return FileError{"Failed to initialize inotify"_s}; }
+    if (inotify_add_watch(m_fd, dir.data(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        stop();
+        return FileError{"Failed to watch the directory of the file"_s};
+    }
+    return {};
+}
+
+bool FileWatcher::wait() {
+    alignas(inotify_event) char buf[4096];
+    while (m_fd >= 0) {
+        const ssize_t len = ::read(m_fd, buf, sizeof(buf));
+        if (len < 0 && errno == EINTR) continue;
+        if (len <= 0) return false;
+        bool changed = false;
+        for (const char* it = buf; it < buf + len;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(it);
+            if (event->len > 0 && StringView{event->name} == m_name.view()) changed = true;
+            it += sizeof(inotify_event) + event->len;
+        }
+        if (!changed) continue;
+        // a save is often several events in a row, swallow the rest of them
+        pollfd pfd{m_fd, POLLIN, 0};
+        while (poll(&pfd, 1, settle_ms) > 0) {
+            if (::read(m_fd, buf, sizeof(buf)) <= 0) break;
+        }
+        return true;
+    }
+    return false;
+}
+
+void FileWatcher::stop() {
+    if (m_fd >= 0) ::close(m_fd);
+    m_fd = -1;
+}
+#else
+static int64_t change_stamp(const Path& path) {
+    struct stat st {};
+    if (stat(path.string().data(), &st) != 0) return -1;
+    return static_cast<int64_t>(st.st_mtime) * 1'000'003 + static_cast<int64_t>(st.st_size);
+}
+
+// no change notifications here, poll the modification time instead
+DiscardResult<FileError> FileWatcher::watch(const Path& path) {
+    m_path = path;
+    m_last_change = change_stamp(path);
+    if (m_last_change < 0) { return FileError{"Failed to watch the file"_s}; }
+    return {};
+}
+
+bool FileWatcher::wait() {
+    constexpr unsigned poll_us = 200'000;
+    for (;;) {
+        usleep(poll_us);
+        const int64_t stamp = change_stamp(m_path);
+        if (stamp != m_last_change) {
+            m_last_change = stamp;
+            usleep(settle_ms * 1000);
+            return true;
+        }
+    }
+}
+
+void FileWatcher::stop() {}
+#endif
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+#include <File.hpp>
+#include <Path.hpp>
+#include <Types.hpp>
+
+using namespace ARLib;
+
+// Waits for a file to be written. Editors often save by replacing the file, so the directory holding it is watched
+// rather than the file itself.
+class FileWatcher {
+#ifdef _WIN32
+    void* m_handle = nullptr;
+#elif defined(__linux__)
+    int m_fd = -1;
+    String m_name{};
+#else
+    Path m_path{};
+    int64_t m_last_change = 0;
+#endif
+
+    public:
+    FileWatcher() = default;
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+    ~FileWatcher() { stop(); }
+    DiscardResult<FileError> watch(const Path& path);
+    // blocks until the file may have changed, false if the watch broke down
+    bool wait();
+    void stop();
+};
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "Images.h"
+#include <Vector.hpp>
+
+#ifdef _MSC_VER
+#define FSCHAR(x) L##x
+#else
+#define FSCHAR(x) x
+#endif
+
+static Path replace_extension(const Path& path, FsStringView ext) {
+    FsString orig = path.extension().string();
+    return path.string().replace(orig.view(), ext);
+}
+
+// every word is formatted into its own fixed-size slot of the text, so blocks can be formatted independently and
+// the file is written with one call
+bool write_code_image(const Path& source, const ThreadPool& pool, const uint32_t* words, size_t count, bool binary) {
+    constexpr size_t line_size = 9;
+    constexpr size_t block_size = 16 * 1024;
+    Path instruction_file = replace_extension(source, binary ? FSCHAR(".cbin") : FSCHAR(".cod"));
+    OutputFile out{};
+    if (out.open(instruction_file).is_error()) { return false; }
+    if (binary) {
+        out.write(words, count * sizeof(uint32_t));
+    } else {
+        Vector<char> text{};
+        text.resize(count * line_size);
+        const size_t blocks = (count + block_size - 1) / block_size;
+        pool.parallel_for(blocks, [&](size_t i) {
+            const size_t first = i * block_size;
+            const size_t last = first + block_size < count ? first + block_size : count;
+            for (size_t idx = first; idx < last; ++idx) {
+                char* line = text.data() + idx * line_size;
+                format_hex(line, words[idx], 8, HexCase::Lower);
+                line[8] = '\n';
+            }
+        });
+        out.write(text.data(), text.size());
+    }
+    return !out.close().is_error();
+}
+
+bool write_data_image(const Path& source, const OutputSpan* spans, size_t count) {
+    Path ro_data_bin = replace_extension(source, FSCHAR(".bin"));
+    Path ro_data_dat = replace_extension(source, FSCHAR(".dat"));
+    OutputFile out{};
+    if (out.open(ro_data_bin).is_error()) { return false; }
+    out.write_spans(spans, count);
+    if (out.close().is_error()) { return false; }
+    if (out.open(ro_data_dat).is_error()) { return false; }
+    for (size_t s = 0; s < count; ++s) {
+        const uint8_t* data = static_cast<const uint8_t*>(spans[s].data);
+        for (size_t i = 0; i < spans[s].size / sizeof(uint64_t); ++i) {
+            uint64_t word;
+            ARLib::memcpy(&word, data + i * sizeof(uint64_t), sizeof(uint64_t));
+            out.put_hex(word, 16, HexCase::Lower);
+            out.put('\n');
+        }
+    }
+    return !out.close().is_error();
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#pragma once
+#include "OutputFile.h"
+#include "ThreadPool.h"
+#include <Path.hpp>
+#include <Types.hpp>
+
+using namespace ARLib;
+
+// The files an assembly leaves next to its source, named after the source with the extension replaced.
+
+// hex text in <source>.cod, or native-endian words in <source>.cbin if binary is true
+bool write_code_image(const Path& source, const ThreadPool& pool, const uint32_t* words, size_t count, bool binary);
+// the raw data section in <source>.bin and as 64-bit hex words in <source>.dat, every span but the last has to hold
+// whole words
+bool write_data_image(const Path& source, const OutputSpan* spans, size_t count);
\ No newline at end of file
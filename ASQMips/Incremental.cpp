@@ -0,0 +1,183 @@
+#include "Incremental.h"
+#include "FileWatcher.h"
+#include "Stats.h"
+#include <File.hpp>
+#include <Printer.hpp>
+
+static bool is_line_start(StringView text, size_t pos) {
+    return pos == 0 || text[pos - 1] == '\n';
+}
+
+// The smallest run of whole lines that differs between the two texts: [begin, old_end) of the old text became
+// [begin, new_end) of the new one. Returns false if the texts are the same.
+static bool changed_lines(StringView old_text, StringView new_text, size_t& begin, size_t& old_end, size_t& new_end) {
+    const size_t shortest = old_text.size() < new_text.size() ? old_text.size() : new_text.size();
+    size_t prefix = 0;
+    while (prefix < shortest && old_text[prefix] == new_text[prefix])
+        ++prefix;
+    if (prefix == shortest && old_text.size() == new_text.size()) return false;
+    size_t suffix = 0;
+    while (suffix < shortest - prefix &&
+           old_text[old_text.size() - 1 - suffix] == new_text[new_text.size() - 1 - suffix])
+        ++suffix;
+    begin = prefix;
+    while (!is_line_start(old_text, begin))
+        --begin;
+    old_end = old_text.size() - suffix;
+    new_end = new_text.size() - suffix;
+    // what follows the ends is the same in both texts, so they can move forward together
+    while (old_end < old_text.size() && !(is_line_start(old_text, old_end) && is_line_start(new_text, new_end))) {
+        ++old_end;
+        ++new_end;
+    }
+    return true;
+}
+
+// encodes the instructions at index_of(0) ... index_of(count - 1) into their words, the ones still referencing a
+// missing label are left alone until the label shows up
+template <typename IndexFn>
+static void encode_words(const ThreadPool& pool, const Vector<IrInstruction>& instructions, Vector<uint32_t>& words,
+                         size_t count, const IndexFn& index_of) {
+    constexpr size_t block_size = 16 * 1024;
+    const size_t blocks = (count + block_size - 1) / block_size;
+    pool.parallel_for(blocks, [&](size_t i) {
+        const size_t first = i * block_size;
+        const size_t last = first + block_size < count ? first + block_size : count;
+        for (size_t idx = first; idx < last; ++idx) {
+            const size_t k = index_of(idx);
+            if (!instructions[k].has_symbol()) words[k] = instructions[k].encode();
+        }
+    });
+}
+
+bool IncrementalAssembler::read_source(String& text) {
+    File file{m_path};
+    if (auto res = file.open(OpenFileMode::Read); res.is_error()) {
+        Printer::print("Error opening file: {}", res.to_error());
+        return false;
+    }
+    auto contents_or_err = file.read_all();
+    if (contents_or_err.is_error()) {
+        Printer::print("Error opening file: {}", contents_or_err.to_error());
+        return false;
+    }
+    text = contents_or_err.to_ok();
+    return true;
+}
+
+bool IncrementalAssembler::assemble() {
+    String text{};
+    if (!read_source(text)) return false;
+    return assemble_text(move(text));
+}
+
+bool IncrementalAssembler::assemble_text(String text) {
+    m_ready = false;
+    m_tokenizer.load(move(text));
+    if (auto res = m_tokenizer.tokenize(m_pool); res.is_error()) {
+        Printer::print("Error tokenizing file: {}", res.to_error());
+        return false;
+    }
+    return parse_all();
+}
+
+bool IncrementalAssembler::parse_all() {
+    m_last_incremental = false;
+    m_data_written = false;
+    m_parser.reset(true);
+    const bool parsed = !m_parser.parse(m_pool).is_error();
+    m_ready = parsed;
+    if (!parsed || m_parser.has_errors()) return false;
+    const auto& instructions = m_parser.instructions();
+    m_words.clear();
+    m_words.resize(instructions.size());
+    encode_words(m_pool, instructions, m_words, instructions.size(), [](size_t idx) { return idx; });
+    m_last_encoded = m_words.size();
+    if (m_parser.has_unresolved_labels()) return false;
+    return finish();
+}
+
+bool IncrementalAssembler::update() {
+    String text{};
+    if (!read_source(text)) return false;
+    if (!m_ready) return assemble_text(move(text));
+    size_t begin = 0;
+    size_t old_end = 0;
+    size_t new_end = 0;
+    if (!changed_lines(m_tokenizer.source_text(), text.view(), begin, old_end, new_end)) {
+        m_last_incremental = true;
+        m_last_encoded = 0;
+        return !m_parser.has_errors() && !m_parser.has_unresolved_labels();
+    }
+    TokenEdit edit{};
+    if (auto res = m_tokenizer.retokenize(move(text), begin, old_end, new_end, edit); res.is_error()) {
+        m_ready = false;
+        Printer::print("Error tokenizing file: {}", res.to_error());
+        return false;
+    }
+    ReparseResult result{};
+    if (!m_parser.reparse(edit, result)) return parse_all();
+
+    // the words of the replaced instructions make room for the new ones, then whatever is dirty is encoded again
+    Vector<uint32_t> words{};
+    words.resize(m_words.size() - result.removed + result.added);
+    for (size_t k = 0; k < result.first; ++k) {
+        words[k] = m_words[k];
+    }
+    for (size_t k = result.first + result.removed; k < m_words.size(); ++k) {
+        words[k - result.removed + result.added] = m_words[k];
+    }
+    m_words = move(words);
+    encode_words(m_pool, m_parser.instructions(), m_words, result.dirty.size(),
+                 [&](size_t idx) { return static_cast<size_t>(result.dirty[idx]); });
+    m_last_incremental = true;
+    m_last_encoded = result.dirty.size();
+    if (m_parser.has_unresolved_labels()) {
+        m_parser.resolve_labels();
+        return false;
+    }
+    return finish();
+}
+
+// code edits never touch the data section, it's only written again after a full pass
+bool IncrementalAssembler::finish() {
+    if (m_rodata && !m_data_written) {
+        if (!m_parser.dump_binary_data()) {
+            Printer::print("Error dumping binary data because {}", last_error());
+            return false;
+        }
+        m_data_written = true;
+    }
+    if (!m_parser.write_instructions(m_pool, m_words, m_binary)) {
+        Printer::print("Error writing encoded instructions because {}", last_error());
+        return false;
+    }
+    return true;
+}
+
+bool IncrementalAssembler::watch() {
+    FileWatcher watcher{};
+    if (auto res = watcher.watch(m_path); res.is_error()) {
+        Printer::print("Error watching file: {}", res.to_error());
+        return false;
+    }
+    auto report = [&](bool ok, uint64_t start_ns) {
+        const uint64_t elapsed_us = (Stats::now_ns() - start_ns) / 1000;
+        if (!ok) {
+            Printer::print("File {} has errors, outputs were not updated", m_path);
+        } else if (m_last_incremental) {
+            Printer::print("File {} reassembled in {} us, {} of {} instructions encoded again", m_path, elapsed_us,
+                           m_last_encoded, m_words.size());
+        } else {
+            Printer::print("File {} assembled in {} us", m_path, elapsed_us);
+        }
+    };
+    uint64_t start_ns = Stats::now_ns();
+    report(assemble(), start_ns);
+    while (watcher.wait()) {
+        start_ns = Stats::now_ns();
+        report(update(), start_ns);
+    }
+    Printer::print("Stopped watching file {}", m_path);
+    return false;
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+#include "Parser.h"
+#include "ThreadPool.h"
+#include "Tokenizer.h"
+#include <Path.hpp>
+#include <String.hpp>
+#include <Vector.hpp>
+
+using namespace ARLib;
+
+// Keeps the tokens, the parse and the encoded words of a source between assemblies. An edit to a few lines of code
+// only re-tokenizes those lines, re-parses their statements and encodes again the instructions whose words changed.
+// Whatever can't be patched in place (directives, data, errors) is assembled from scratch. Outputs are only written
+// when the source assembles cleanly, so the previous ones stay around while the file is being edited.
+class IncrementalAssembler {
+    Path m_path;
+    Tokenizer m_tokenizer;
+    Parser m_parser;
+    Vector<uint32_t> m_words{};
+    const ThreadPool& m_pool;
+    bool m_binary;
+    bool m_rodata;
+    // the tokenizer and the parser hold a complete pass that later edits can be applied to
+    bool m_ready = false;
+    // the data section of the current full pass is on disk
+    bool m_data_written = false;
+    bool m_last_incremental = false;
+    size_t m_last_encoded = 0;
+    bool read_source(String& text);
+    bool assemble_text(String text);
+    bool parse_all();
+    bool finish();
+
+    public:
+    IncrementalAssembler(const Path& path, const ThreadPool& pool, bool binary, bool rodata) :
+        m_path(path), m_tokenizer(path), m_parser(m_tokenizer), m_pool(pool), m_binary(binary), m_rodata(rodata) {}
+    IncrementalAssembler(const IncrementalAssembler&) = delete;
+    IncrementalAssembler& operator=(const IncrementalAssembler&) = delete;
+    // assembles the whole file, returns false if it has errors
+    bool assemble();
+    // reads the file again and assembles what changed since the previous call
+    bool update();
+    // assembles the file, then again every time it's written to, until watching it fails
+    bool watch();
+};
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+    m_data(other.m_data), m_size(other.m_size), m_mapped(other.m_mapped)
+#ifdef _WIN32
+    ,
+    m_file_handle(other.m_file_handle), m_mapping_handle(other.m_mapping_handle)
+#endif
+{
+    other.m_data = nullptr;
+    other.m_size = 0;
+    other.m_mapped = false;
+#ifdef _WIN32
+    other.m_file_handle = nullptr;
+    other.m_mapping_handle = nullptr;
+#endif
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this == &other) return *this;
+    unmap();
+    m_data = other.m_data;
+    m_size = other.m_size;
+    m_mapped = other.m_mapped;
+    other.m_data = nullptr;
+    other.m_size = 0;
+    other.m_mapped = false;
+#ifdef _WIN32
+    m_file_handle = other.m_file_handle;
+    m_mapping_handle = other.m_mapping_handle;
+    other.m_file_handle = nullptr;
+    other.m_mapping_handle = nullptr;
+#endif
+    return *this;
+}
+
+#ifdef _WIN32
+DiscardResult<FileError> MappedFile::map(const Path& path) {
+    unmap();
+    HANDLE file = CreateFileW(path.string().data(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { return FileError{"Failed to open file for mapping"_s}; }
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return FileError{"Failed to query file size"_s};
+    }
+    m_file_handle = file;
+    m_size = static_cast<size_t>(size.QuadPart);
+    m_mapped = true;
+    // zero-sized files can't be mapped, they are represented by an empty view
+    if (m_size == 0) return {};
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        unmap();
+        return FileError{"Failed to create file mapping"_s};
+    }
+    m_mapping_handle = mapping;
+    m_data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == nullptr) {
+        unmap();
+        return FileError{"Failed to map view of file"_s};
+    }
+    return {};
+}
+
+void MappedFile::unmap() {
+    if (m_data) UnmapViewOfFile(m_data);
+    if (m_mapping_handle) CloseHandle(m_mapping_handle);
+    if (m_file_handle) CloseHandle(m_file_handle);
+    m_data = nullptr;
+    m_mapping_handle = nullptr;
+    m_file_handle = nullptr;
+    m_size = 0;
+    m_mapped = false;
+}
+#else
+DiscardResult<FileError> MappedFile::map(const Path& path) {
+    unmap();
+    int fd = ::open(path.string().data(), O_RDONLY);
+    if (fd < 0) { return FileError{"Failed to open file for mapping"_s}; }
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return FileError{"File can't be mapped"_s};
+    }
+    m_size = static_cast<size_t>(st.st_size);
+    m_mapped = true;
+    // zero-sized files can't be mapped, they are represented by an empty view
+    if (m_size == 0) {
+        ::close(fd);
+        return {};
+    }
+    void* addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        m_size = 0;
+        m_mapped = false;
+        return FileError{"Failed to map file"_s};
+    }
+    madvise(addr, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const char*>(addr);
+    return {};
+}
+
+void MappedFile::unmap() {
+    if (m_data) munmap(const_cast<char*>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+    m_mapped = false;
+}
+#endif
\ No newline at end of file
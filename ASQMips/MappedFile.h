@@ -0,0 +1,32 @@
+#pragma once
+#include <File.hpp>
+#include <Path.hpp>
+#include <StringView.hpp>
+#include <Types.hpp>
+
+using namespace ARLib;
+
+// Read-only memory mapping of a whole file, the view stays valid until the object is unmapped or destroyed.
+class MappedFile {
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+    bool m_mapped = false;
+#ifdef _WIN32
+    void* m_file_handle = nullptr;
+    void* m_mapping_handle = nullptr;
+#endif
+
+    public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    ~MappedFile() { unmap(); }
+    DiscardResult<FileError> map(const Path& path);
+    void unmap();
+    bool is_mapped() const { return m_mapped; }
+    size_t size() const { return m_size; }
+    const char* data() const { return m_data; }
+    StringView view() const { return m_size == 0 ? StringView{} : StringView{m_data, m_data + m_size}; }
+};
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+#include <Printer.hpp>
+#include <String.hpp>
+
+using namespace ARLib;
+
+// Where diagnostics and dumps go: stdout by default, or a string when they're collected to be sent to a client.
+class MessageSink {
+    String* m_capture = nullptr;
+
+    public:
+    MessageSink() = default;
+    // nullptr goes back to printing
+    void capture_into(String* capture) { m_capture = capture; }
+    template <typename Fmt, typename... Args>
+    void print(const Fmt& fmt, const Args&... args) const {
+        if (m_capture == nullptr) {
+            Printer::print(fmt, args...);
+            return;
+        }
+        *m_capture += Printer::format(fmt, args...);
+        *m_capture += '\n';
+    }
+};
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+#include <Array.hpp>
+#include <StringView.hpp>
+#include <Types.hpp>
+
+using namespace ARLib;
+
+// Fast paths for the common shapes of numeric literals. They return false instead of guessing for anything they
+// don't handle exactly, so callers can fall back to the general conversions.
+
+// true if all 8 bytes of the little-endian chunk are ASCII digits
+constexpr bool is_eight_digits(uint64_t chunk) {
+    return ((chunk & 0xF0F0F0F0F0F0F0F0ull) | (((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) ==
+           0x3333333333333333ull;
+}
+
+// value of 8 ASCII digits loaded as a little-endian chunk, converted two, four and eight digits at a time
+constexpr uint32_t eight_digits_value(uint64_t chunk) {
+    constexpr uint64_t mask = 0x000000FF000000FFull;
+    constexpr uint64_t mul1 = 100 + (1000000ull << 32);
+    constexpr uint64_t mul2 = 1 + (10000ull << 32);
+    chunk -= 0x3030303030303030ull;
+    chunk = (chunk * 10) + (chunk >> 8);
+    chunk = (((chunk & mask) * mul1) + (((chunk >> 16) & mask) * mul2)) >> 32;
+    return static_cast<uint32_t>(chunk);
+}
+
+// accumulates the run of digits at it into value, returns the end of the run; value wraps if the run is too long.
+// Constant evaluation can't load the chunks, so it only takes the digit-at-a-time loop.
+constexpr const char* accumulate_digits(const char* it, const char* end, uint64_t& value) {
+    while (!__builtin_is_constant_evaluated() && end - it >= 8) {
+        uint64_t chunk;
+        ARLib::memcpy(&chunk, it, sizeof(chunk));
+        if (!is_eight_digits(chunk)) break;
+        value = value * 100000000ull + eight_digits_value(chunk);
+        it += 8;
+    }
+    while (it != end && *it >= '0' && *it <= '9') {
+        value = value * 10 + static_cast<uint64_t>(*it - '0');
+        ++it;
+    }
+    return it;
+}
+
+// magnitude of an optionally negative decimal integer of at most 19 digits, which always fits in 64 bits
+constexpr bool parse_decimal_magnitude(StringView text, uint64_t& magnitude) {
+    constexpr size_t max_digits = 19;
+    const char* it = text.data();
+    const char* const end = it + text.size();
+    if (it != end && *it == '-') ++it;
+    const char* const digits = it;
+    uint64_t value = 0;
+    it = accumulate_digits(it, end, value);
+    if (it != end || it == digits || static_cast<size_t>(it - digits) > max_digits) return false;
+    magnitude = value;
+    return true;
+}
+
+// Decimal literals of the form [-]digits.digits whose digits fit exactly in a double's mantissa and whose scale is
+// an exactly representable power of ten; dividing the two is then correctly rounded.
+constexpr bool parse_simple_double(StringView text, double& result) {
+    constexpr Array<double, 23> powers_of_ten{1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                              1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    constexpr uint64_t max_mantissa = 1ull << 53;
+    constexpr size_t max_digits = 19;
+    const char* it = text.data();
+    const char* const end = it + text.size();
+    const bool negative = it != end && *it == '-';
+    if (negative) ++it;
+    const char* const int_digits = it;
+    uint64_t mantissa = 0;
+    it = accumulate_digits(it, end, mantissa);
+    const size_t int_count = static_cast<size_t>(it - int_digits);
+    if (int_count == 0 || it == end || *it != '.') return false;
+    const char* const frac_digits = ++it;
+    it = accumulate_digits(it, end, mantissa);
+    const size_t frac_count = static_cast<size_t>(it - frac_digits);
+    if (it != end || frac_count == 0 || frac_count >= powers_of_ten.size() || int_count + frac_count > max_digits ||
+        mantissa > max_mantissa) {
+        return false;
+    }
+    const double value = static_cast<double>(mantissa) / powers_of_ten[frac_count];
+    result = negative ? -value : value;
+    return true;
+}
\ No newline at end of file
@@ -1,6 +1,10 @@
 #include "Parser.h"
 #include "DirectiveParser.h"
+#include "Images.h"
 #include "InstructionParser.h"
+#include "MappedFile.h"
+#include "NumberParser.h"
+#include "OutputFile.h"
 #include <BigInt.hpp>
 
 #define CHAR_BIT 8
@@ -9,53 +13,54 @@ using namespace ARLib;
 bool Parser::assert_next_token(tit it, tit end, TokenKind kind, bool force_errors) {
     if (it == end) {
         m_has_errored = true;
-        if (force_errors) { m_tokenizer.print_error("unexpected end of token stream was reached"_sv, *it); }
+        if (force_errors && !m_quiet) {
+            m_tokenizer.print_error("unexpected end of token stream was reached"_sv, *it);
+        }
         return false;
     }
     if ((*it).kind() != kind) {
         m_has_errored = true;
-        auto error_message =
-        "Expected token of kind "_s + enum_to_str(kind) + " but got "_s + enum_to_str((*it).kind());
-        if (force_errors) { m_tokenizer.print_error(error_message.view(), *it); }
+        if (force_errors && !m_quiet) {
+            auto error_message =
+            "Expected token of kind "_s + enum_to_str(kind) + " but got "_s + enum_to_str((*it).kind());
+            m_tokenizer.print_error(error_message.view(), *it);
+        }
         return false;
     }
     return true;
 }
 
+// only a probe, unlike assert_next_token a mismatch doesn't count as an error
 bool Parser::assert_next_one_of(tit it, tit end, std::initializer_list<TokenKind> kinds) {
+    if (it == end) return false;
     for (const TokenKind& kind : kinds) {
-        if (assert_next_token(it, end, kind, false)) return true;
+        if ((*it).kind() == kind) return true;
     }
     return false;
 }
 
-struct BoolSetOnce {
-    bool m_value = false;
-    constexpr BoolSetOnce() = default;
-    constexpr operator bool() const { return m_value; }
-    constexpr BoolSetOnce& operator=(bool val) {
-        if (!m_value) { m_value = val; }
-        return *this;
-    }
-};
+void Parser::report(const StringView& error, const Token& tok) {
+    m_has_errored = true;
+    if (!m_quiet) m_tokenizer.print_error(error, tok);
+}
 
 tit Parser::parse_section_change(tit it, [[maybe_unused]] tit end, Section& section) {
     // look for .data or .text or .code
     const Token& ident = *it;
-    if (ident.token() == "data"_sv) {
+    if (text(ident) == "data"_sv) {
         section = Section::Data;
-    } else if (ident.token() == "text"_sv || ident.token() == "code"_sv) {
+    } else if (text(ident) == "text"_sv || text(ident) == "code"_sv) {
         section = Section::Text;
     } else {
-        m_has_errored = true;
-        m_tokenizer.print_error("Expected .data, .text or code"_sv, ident);
+        report("Expected .data, .text or code"_sv, ident);
     }
     ++it;
     return it;
 }
 
-uint8_t Parser::m_ro_data[32768]{};
-uint8_t Parser::m_code_data[32768]{};
+void Parser::write_data(const Token& tok, uint64_t address, const void* data, size_t size) {
+    if (!m_data_section.write(address, data, size)) { report("data section is too big"_sv, tok); }
+}
 
 tit Parser::parse_comma_separated_list(tit it, tit end, size_t value_size) {
     while (assert_next_one_of(it, end, {TokenKind::Integer, TokenKind::Real})) {
@@ -76,14 +81,17 @@ tit Parser::parse_comma_separated_list(tit it, tit end, size_t value_size) {
                     return 0;
                 }
             };
-            BigInt bval{tok.token()};
+            // only literals that could overflow 64 bits need a BigInt
+            uint64_t magnitude;
+            if (!parse_decimal_magnitude(text(tok), magnitude)) magnitude = BigInt{text(tok)}.to_absolute_value();
             uint64_t max_val = get_max_val_for_size(value_size);
-            uint64_t val = bval.to_absolute_value() & max_val;
-            ARLib::memcpy(m_ro_data + current_address, &val, value_size);
+            uint64_t val = magnitude & max_val;
+            write_data(tok, current_address, &val, value_size);
             current_address += value_size;
         } else {
-            double val = MUST(StrViewToDouble(tok.token()));
-            ARLib::memcpy(m_ro_data + current_address, &val, value_size);
+            double val;
+            if (!parse_simple_double(text(tok), val)) val = MUST(StrViewToDouble(text(tok)));
+            write_data(tok, current_address, &val, value_size);
             current_address += value_size;
         }
         ++it;
@@ -93,6 +101,18 @@ tit Parser::parse_comma_separated_list(tit it, tit end, size_t value_size) {
     return it;
 }
 
+// copies the whole file named by tok into the data section, the path is relative to the working directory
+void Parser::include_binary(const Token& tok) {
+    m_includes_files = true;
+    MappedFile file{};
+    if (file.map(Path{text(tok).extract_string()}).is_error()) {
+        report("could not read the included file"_sv, tok);
+        return;
+    }
+    write_data(tok, current_address, file.data(), file.size());
+    current_address += file.size();
+}
+
 template <Integral T>
 static T align_address(T val, uint64_t off, uint64_t align = sizeof(uint64_t)) {
     T align_v = static_cast<T>(align);
@@ -106,12 +126,11 @@ static T align_address(T val, uint64_t off, uint64_t align = sizeof(uint64_t)) {
 tit Parser::parse_directive(tit it, tit end, Section& section) {
     if (!assert_next_token(++it, end, TokenKind::Directive)) return it;
     const auto& directive = *it;
-    auto dirit =
-    directive_map.find(directive.token(), [](const auto& dir, const StringView name) { return dir.name == name; });
-    HARD_ASSERT(dirit != directive_map.end(), "directive not found in directive map");
+    const auto* dirit = directive_map.find(text(directive));
+    HARD_ASSERT(dirit != nullptr, "directive not found in directive map");
     // we assume it is found because we checked for it in the tokenizer
 
-    const auto& dir = (*dirit).val;
+    const auto& dir = *dirit;
     switch (dir.val) {
     case DirectiveType::data:
     case DirectiveType::text:
@@ -121,37 +140,43 @@ tit Parser::parse_directive(tit it, tit end, Section& section) {
     case DirectiveType::org:
         if (!assert_next_token(++it, end, TokenKind::Integer)) return it;
         if (section == Section::Data) {
-            current_address = MUST(StrViewToU64((*it).token()));
+            current_address = MUST(StrViewToU64(text(*it)));
         } else {
-            current_pc = MUST(StrViewToUInt((*it).token()));
+            current_pc = MUST(StrViewToUInt(text(*it)));
         }
         ++it;
         break;
     case DirectiveType::align:
         if (!assert_next_token(++it, end, TokenKind::Integer)) return it;
         if (section == Section::Data) {
-            current_address = align_address(current_address, 0, MUST(StrViewToU64((*it).token())));
+            current_address = align_address(current_address, 0, MUST(StrViewToU64(text(*it))));
         } else {
-            current_pc = align_address(current_pc, 0, MUST(StrViewToU64((*it).token())));
+            current_pc = align_address(current_pc, 0, MUST(StrViewToU64(text(*it))));
         }
         ++it;
         break;
     case DirectiveType::space:
         if (!assert_next_token(++it, end, TokenKind::Integer)) return it;
-        current_address = align_address(current_address, MUST(StrViewToU64((*it).token())));
+        current_address = align_address(current_address, MUST(StrViewToU64(text(*it))));
         ++it;
         break;
     case DirectiveType::ascii:
         if (!assert_next_token(++it, end, TokenKind::String)) return it;
-        ARLib::memcpy(m_ro_data + current_address, (*it).token().data(), (*it).token().length());
-        current_address = align_address(current_address, (*it).token().length());
+        write_data(*it, current_address, text(*it).data(), text(*it).length());
+        current_address = align_address(current_address, text(*it).length());
         ++it;
         break;
     case DirectiveType::asciiz:
         if (!assert_next_token(++it, end, TokenKind::String)) return it;
-        ARLib::memcpy(m_ro_data + current_address, (*it).token().data(), (*it).token().length());
-        m_ro_data[current_address + (*it).token().length()] = '\0';
-        current_address = align_address(current_address, (*it).token().length() + 1);
+        write_data(*it, current_address, text(*it).data(), text(*it).length());
+        write_data(*it, current_address + text(*it).length(), "", 1);
+        current_address = align_address(current_address, text(*it).length() + 1);
+        ++it;
+        break;
+    case DirectiveType::incbin:
+        if (!assert_next_token(++it, end, TokenKind::String)) return it;
+        include_binary(*it);
+        current_address = align_address(current_address, 0);
         ++it;
         break;
     case DirectiveType::byte:
@@ -178,47 +203,37 @@ tit Parser::parse_directive(tit it, tit end, Section& section) {
     return it;
 }
 
-template <>
-struct ARLib::cxpr::Hasher<ARLib::String> {
-    constexpr uint32_t operator()(const String& str) const { return crc32::calculate(str.view()); }
-};
-
 tit Parser::parse_instruction(tit begin, tit end) {
     auto it = begin;
     const auto& tok = *it;
     ++it;
-    auto ins_name = tok.token().extract_string();
-    if ((*it).kind() == TokenKind::Dot) {
+    // dotted mnemonics (e.g. cvt.d.l) are looked up from their pieces
+    Array<StringView, 3> name_pieces{text(tok)};
+    size_t piece_count = 1;
+    while (piece_count < name_pieces.size() && it != end && (*it).kind() == TokenKind::Dot) {
         ++it;
         if (!assert_next_token(it, end, TokenKind::Identifier)) return it;
-        ins_name += "."_s + (*it).token().extract_string();
+        name_pieces[piece_count++] = text(*it);
         ++it;
     }
-    if ((*it).kind() == TokenKind::Dot) {
-        ++it;
-        if (!assert_next_token(it, end, TokenKind::Identifier)) return it;
-        ins_name += "."_s + (*it).token().extract_string();
-        ++it;
-    }
-    auto instit =
-    instruction_map.find(ins_name, [](const auto& inst, const String& name) { return inst.name == name.view(); });
-    if (instit == instruction_map.end()) {
-        m_tokenizer.print_error("invalid instruction", tok);
+    const auto* instit = instruction_map.find(name_pieces.data(), piece_count);
+    if (instit == nullptr) {
+        report("invalid instruction"_sv, tok);
         return it;
     }
-    const auto& inst = (*instit).val;
-    InstructionData data{inst};
-    data.pc_address = current_pc;
-    auto add_immediate = [&](const Token& arg, Immediate& imm) {
+    const auto& inst = *instit;
+    IrInstruction data{inst.insn, current_pc};
+    auto add_immediate = [&](const Token& arg) {
         switch (arg.kind()) {
         case TokenKind::Integer:
-            imm = MUST(StrViewToInt(arg.token()));
+            data.set_immediate(static_cast<int32_t>(MUST(StrViewToInt(text(arg)))));
             break;
         case TokenKind::Real:
-            imm = MUST(StrViewToDouble(arg.token()));
+            data.set_immediate(MUST(StrViewToDouble(text(arg))));
             break;
         case TokenKind::Identifier:
-            imm = arg.token();
+            // resolved as soon as the label is known
+            data.set_symbol(arg.symbol());
             break;
         default:
             ASSERT_NOT_REACHED("invalid immediate");
@@ -234,13 +249,12 @@ tit Parser::parse_instruction(tit begin, tit end) {
     };
     auto add_register = [&](const Token& arg, RegisterEnum& reg) -> RegisterEnum {
         if (!assert_next_token(it, end, TokenKind::Identifier)) return RegisterEnum::r0;
-        auto regit =
-        register_map.find(arg.token(), [](const auto& reg, const StringView name) { return reg.name == name; });
-        if (regit == register_map.end()) {
-            m_tokenizer.print_error("register not found in register map", arg);
+        const auto* regit = register_map.find(text(arg));
+        if (regit == nullptr) {
+            report("register not found in register map"_sv, arg);
             return RegisterEnum::r0;
         }
-        const auto& regv = (*regit).val;
+        const auto& regv = *regit;
         reg = regv.val;
         ++it;
         return regv.val;
@@ -250,25 +264,20 @@ tit Parser::parse_instruction(tit begin, tit end) {
         const auto& arg = *it;
         switch (inst.arg_types[i]) {
         case ArgumentType::Imm:
-            data.args[i].m_type = ArgumentType::Imm;
-            add_immediate(arg, data.args[i].m_imm());
+            add_immediate(arg);
             break;
         case ArgumentType::Freg: {
-            data.args[i].m_type = ArgumentType::Freg;
-            auto reg = add_register(arg, data.args[i].m_reg());
-            if (!is_register_floating_point(reg)) {
-                m_tokenizer.print_error("register is not a floating point register", arg);
-            }
+            auto reg = add_register(arg, data.regs[i]);
+            if (!is_register_floating_point(reg)) { report("register is not a floating point register"_sv, arg); }
         } break;
         case ArgumentType::Reg: {
-            data.args[i].m_type = ArgumentType::Reg;
-            auto reg = add_register(arg, data.args[i].m_reg());
-            if (!is_register_integer(reg)) { m_tokenizer.print_error("register is not an integer register", arg); }
+            auto reg = add_register(arg, data.regs[i]);
+            if (!is_register_integer(reg)) { report("register is not an integer register"_sv, arg); }
         } break;
         case ArgumentType::ImmWReg:
-            add_immediate(arg, data.args[i].m_imm_reg().first());
+            add_immediate(arg);
             if (!assert_next_token(it, end, TokenKind::OpenParens)) return it;
-            add_register(*(++it), data.args[i].m_imm_reg().second());
+            add_register(*(++it), data.regs[i]);
             if (!assert_next_token(it, end, TokenKind::CloseParens)) return it;
             ++it; // skip parens
             break;
@@ -279,18 +288,63 @@ tit Parser::parse_instruction(tit begin, tit end) {
         }
     }
     current_pc += sizeof(uint32_t);
-    m_instructions.append(move(data));
+    m_instructions.append(data);
+    if (m_track_origins) {
+        const auto tokens_begin = m_tokenizer.tokens().begin();
+        m_origins.append(InstructionOrigin{static_cast<uint32_t>(begin - tokens_begin),
+                                           static_cast<uint32_t>(it - tokens_begin),
+                                           data.has_symbol() ? data.symbol() : Token::no_symbol});
+    }
+    if (data.has_symbol() && !m_relocatable) reference_symbol(m_instructions.size() - 1);
     return it;
 }
 
-DiscardResult<> Parser::parse() {
-    BoolSetOnce has_errored{};
-    Section section = Section::None;
-    const auto& tokens = m_tokenizer.tokens();
-    auto begin = tokens.begin();
-    auto end = tokens.end();
-    auto it = begin;
-    while (it != end) {
+void Parser::define_label(uint32_t token, size_t address, Section section) {
+    if (m_relocatable) {
+        m_local_labels.append(LocalLabel{token, address});
+    } else {
+        add_label(token, address, section);
+    }
+}
+
+// defines the label and patches every reference to it seen so far
+void Parser::add_label(uint32_t token, size_t address, Section section) {
+    const Token& ident = m_tokenizer.tokens()[token];
+    auto& symbol = m_symbols[ident.symbol()];
+    if (symbol.defined) {
+        report("duplicate label"_sv, ident);
+        return;
+    }
+    symbol.defined = true;
+    symbol.address = address;
+    symbol.token = token;
+    symbol.in_text = section == Section::Text;
+    m_label_order.append(ident.symbol());
+    for (uint32_t fixup = symbol.first_fixup; fixup != SymbolInfo::no_fixup; fixup = m_fixups[fixup].next) {
+        m_instructions[m_fixups[fixup].instruction].set_immediate(static_cast<int32_t>(address));
+        --m_unresolved;
+    }
+    symbol.first_fixup = SymbolInfo::no_fixup;
+}
+
+// resolves the reference of the instruction right away if its label is already defined, else queues it on the
+// label's fixup list
+void Parser::reference_symbol(size_t instruction) {
+    auto& insn = m_instructions[instruction];
+    auto& symbol = m_symbols[insn.symbol()];
+    if (symbol.defined) {
+        insn.set_immediate(static_cast<int32_t>(symbol.address));
+        return;
+    }
+    m_fixups.append(Fixup{static_cast<uint32_t>(instruction), symbol.first_fixup});
+    symbol.first_fixup = static_cast<uint32_t>(m_fixups.size() - 1);
+    ++m_unresolved;
+}
+
+// parses whole statements until the one starting at or after the token at index stop, or the end
+DiscardResult<> Parser::parse_statements(tit& it, size_t stop, tit end, Section& section) {
+    const auto begin = m_tokenizer.tokens().begin();
+    while (it != end && static_cast<size_t>(it - begin) < stop) {
         const Token& cur = *it;
         switch (section) {
         case Section::None:
@@ -306,9 +360,9 @@ DiscardResult<> Parser::parse() {
                 break;
             case TokenKind::Label: {
                 // add label
-                const auto& ident = *it;
+                const auto ident = static_cast<uint32_t>(it - begin);
                 if (!assert_next_token(++it, end, TokenKind::Colon)) break;
-                m_labels.insert(ident.token(), Label{ident.token(), current_address});
+                define_label(ident, current_address, section);
                 ++it; // skip colon
             } break;
             default:
@@ -325,19 +379,18 @@ DiscardResult<> Parser::parse() {
             } break;
             case TokenKind::Label: {
                 // add label
-                const auto& ident = *it;
+                const auto ident = static_cast<uint32_t>(it - begin);
                 if (!assert_next_token(++it, end, TokenKind::Colon)) break;
-                m_labels.insert(ident.token(), Label{ident.token(), current_pc});
+                define_label(ident, current_pc, section);
                 ++it; // skip colon
             } break;
             case TokenKind::Dot: {
                 if (!assert_next_token(++it, end, TokenKind::Directive)) break;
                 const auto& directive = *it;
-                auto dirit = directive_map.find(
-                directive.token(), [](const auto& dir, const StringView name) { return dir.name == name; });
-                HARD_ASSERT(dirit != directive_map.end(), "directive not found in directive map");
+                const auto* dirit = directive_map.find(text(directive));
+                HARD_ASSERT(dirit != nullptr, "directive not found in directive map");
                 // we assume it is found because we checked for it in the tokenizer
-                const auto& dir = (*dirit).val;
+                const auto& dir = *dirit;
                 switch (dir.val) {
                 case DirectiveType::data:
                 case DirectiveType::text:
@@ -346,7 +399,7 @@ DiscardResult<> Parser::parse() {
                     break;
                 case DirectiveType::org: {
                     if (!assert_next_token(++it, end, TokenKind::Integer)) break;
-                    auto res = StrViewToU64((*it).token());
+                    auto res = StrViewToU64(text(*it));
                     if (res.is_error()) return Error{res.to_error()};
                     current_address = res.to_ok();
                     ++it;
@@ -357,96 +410,388 @@ DiscardResult<> Parser::parse() {
                 }
             } break;
             default:
-                Printer::print("Unhandled token: {}", cur);
+                m_has_errored = true;
+                if (!m_quiet) m_tokenizer.messages().print("Unhandled token: {}", m_tokenizer.describe(cur));
                 ++it;
                 break;
             }
         }
     }
-    for (auto& insn : m_instructions) {
-        auto& info = *insn.info;
-        for (size_t i = 0; i < info.arg_count; ++i) {
-            auto& arg = insn.args[i];
-            switch (arg.m_type) {
-            case ArgumentType::Imm: {
-                if (arg.m_imm().contains_type<StringView>()) {
-                    const auto& label = arg.m_imm().get<StringView>();
-                    auto label_info = m_labels.find(label);
-                    if (label_info == m_labels.end()) {
-                        Printer::print("label {} not found", label);
-                        has_errored = true;
-                    } else {
-                        const auto& label_addr = (*label_info).val().address;
-                        arg.m_imm() = static_cast<int32_t>(label_addr);
-                    }
-                }
-            } break;
-            case ArgumentType::ImmWReg: {
-                if (arg.m_imm_reg().first().contains_type<StringView>()) {
-                    const auto& label = arg.m_imm_reg().first().get<StringView>();
-                    auto label_info = m_labels.find(label);
-                    if (label_info == m_labels.end()) {
-                        Printer::print("label {} not found", label);
-                        has_errored = true;
-                    } else {
-                        const auto& label_addr = (*label_info).val().address;
-                        arg.m_imm_reg().first() = static_cast<int32_t>(label_addr);
-                    }
+    return {};
+}
+
+// Parses the chunks the tokenizer split the source into. Chunks with no directives are pure code, they are parsed
+// concurrently with addresses relative to their start and relocated when merged in order. Everything else (and any
+// chunk that doesn't parse cleanly on its own) is parsed serially during the merge, exactly like parse() would.
+DiscardResult<> Parser::parse(const ThreadPool& pool) {
+    const auto& chunk_starts = m_tokenizer.chunk_starts();
+    if (pool.size() <= 1 || chunk_starts.size() < 2) return parse();
+    const auto& tokens = m_tokenizer.tokens();
+    const auto begin = tokens.begin();
+    const auto end = tokens.end();
+    const size_t chunks = chunk_starts.size();
+    auto chunk_stop = [&](size_t i) -> size_t { return i + 1 < chunks ? chunk_starts[i + 1] : tokens.size(); };
+
+    struct ChunkResult {
+        Vector<IrInstruction> instructions{};
+        Vector<LocalLabel> labels{};
+        Vector<InstructionOrigin> origins{};
+        uint32_t size = 0;
+        bool usable = false;
+    };
+    Vector<ChunkResult> results{};
+    results.resize(chunks);
+    pool.parallel_for(chunks, [&](size_t i) {
+        const size_t start = chunk_starts[i];
+        const size_t stop = chunk_stop(i);
+        for (size_t idx = start; idx < stop; ++idx) {
+            if (tokens[idx].kind() == TokenKind::Directive) return;
+        }
+        Parser chunk{m_tokenizer};
+        chunk.m_quiet = true;
+        chunk.m_relocatable = true;
+        chunk.m_track_origins = m_track_origins;
+        Section section = Section::Text;
+        auto it = begin + start;
+        const auto chunk_end = begin + stop;
+        if (chunk.parse_statements(it, stop, chunk_end, section).is_error()) return;
+        if (chunk.m_has_errored || it != chunk_end) return;
+        auto& result = results[i];
+        result.instructions = move(chunk.m_instructions);
+        result.labels = move(chunk.m_local_labels);
+        result.origins = move(chunk.m_origins);
+        result.size = chunk.current_pc;
+        result.usable = true;
+    });
+
+    m_symbols.resize(m_tokenizer.symbols().size());
+    Section section = Section::None;
+    auto it = begin;
+    for (size_t i = 0; i < chunks; ++i) {
+        const size_t stop = chunk_stop(i);
+        const size_t pos = static_cast<size_t>(it - begin);
+        if (pos >= stop) continue;
+        auto& result = results[i];
+        if (pos == chunk_starts[i] && section == Section::Text && result.usable) {
+            // labels and references are replayed in the order the serial parser would have seen them, so
+            // diagnostics and resolution don't depend on the chunking
+            size_t next_label = 0;
+            for (size_t k = 0; k < result.instructions.size(); ++k) {
+                IrInstruction insn = result.instructions[k];
+                while (next_label < result.labels.size() && result.labels[next_label].address <= insn.pc_address) {
+                    const auto& label = result.labels[next_label++];
+                    add_label(label.token, label.address + current_pc, Section::Text);
                 }
-            } break;
-                break;
-            default:
-                break;
+                insn.pc_address += current_pc;
+                m_instructions.append(insn);
+                if (m_track_origins) m_origins.append(result.origins[k]);
+                if (insn.has_symbol()) reference_symbol(m_instructions.size() - 1);
+            }
+            for (; next_label < result.labels.size(); ++next_label) {
+                const auto& label = result.labels[next_label];
+                add_label(label.token, label.address + current_pc, Section::Text);
             }
+            current_pc += result.size;
+            it = begin + stop;
+        } else {
+            TRY(parse_statements(it, stop, end, section));
         }
     }
+    return resolve_labels();
+}
+
+DiscardResult<> Parser::parse() {
+    m_symbols.resize(m_tokenizer.symbols().size());
+    Section section = Section::None;
+    const auto& tokens = m_tokenizer.tokens();
+    auto it = tokens.begin();
+    TRY(parse_statements(it, tokens.size(), tokens.end(), section));
+    return resolve_labels();
+}
+
+// every reference to a defined label was patched when the label was defined, whatever is left points to labels
+// that don't exist
+DiscardResult<> Parser::resolve_labels() {
+    if (m_unresolved == 0) return DiscardResult<>{};
+    const auto& symbols = m_tokenizer.symbols();
+    for (const auto& insn : m_instructions) {
+        if (insn.has_symbol()) m_tokenizer.messages().print("label {} not found", symbols.name(insn.symbol()));
+    }
     return DiscardResult<>{};
 }
 
-#ifdef _MSC_VER
-#define FSCHAR(x) L##x
-#else
-#define FSCHAR(x) x
-#endif
+void Parser::reset(bool track_origins) {
+    m_data_section = SectionBuffer{};
+    m_label_order.clear();
+    m_symbols.clear();
+    m_fixups.clear();
+    m_unresolved = 0;
+    m_instructions.clear();
+    m_local_labels.clear();
+    m_origins.clear();
+    m_has_errored = false;
+    m_track_origins = track_origins;
+    m_includes_files = false;
+    current_address = 0;
+    current_pc = 0;
+}
 
-static Path replace_extension(const Path& path, FsStringView ext) {
-    FsString orig = path.extension().string();
-    return path.string().replace(orig.view(), ext);
+// section the statement starting at the token would be parsed in, from the last section directive before it
+Section Parser::section_at(size_t token) const {
+    const auto& tokens = m_tokenizer.tokens();
+    for (size_t idx = token; idx > 0; --idx) {
+        const Token& tok = tokens[idx - 1];
+        if (tok.kind() != TokenKind::Directive) continue;
+        const auto* dirit = directive_map.find(text(tok));
+        if (dirit == nullptr) continue;
+        switch (dirit->val) {
+        case DirectiveType::data:
+            return Section::Data;
+        case DirectiveType::text:
+        case DirectiveType::code:
+            return Section::Text;
+        default:
+            break;
+        }
+    }
+    return Section::None;
 }
 
-bool Parser::dump_binary_data() const {
-    Path ro_data_bin = replace_extension(m_tokenizer.source_file(), FSCHAR(".bin"));
-    Path ro_data_dat = replace_extension(m_tokenizer.source_file(), FSCHAR(".dat"));
-    FILE* fp = fopen(ro_data_bin.string().data(), "wb");
-    if (!fp) { return false; }
-    ARLib::fwrite(m_ro_data, 1, current_address, fp);
-    ARLib::fclose(fp);
-    fp = fopen(ro_data_dat.string().data(), "w");
-    const uint64_t* data = reinterpret_cast<const uint64_t*>(m_ro_data);
-    for (size_t i = 0; i < current_address / sizeof(uint64_t); ++i) {
-        ARLib::fprintf(fp, "%016llx\n", data[i]);
-    }
-    ARLib::fclose(fp);
+// Instructions only ever advance the pc by one word, so in the text section the instruction at index i is always at
+// 4 * i and an edit moves everything after it by the difference in instruction count.
+bool Parser::reparse(const TokenEdit& edit, ReparseResult& result) {
+    if (!m_track_origins || m_has_errored || !edit.plain) return false;
+    if (section_at(edit.first) != Section::Text) return false;
+    const auto& tokens = m_tokenizer.tokens();
+    const int64_t token_shift = static_cast<int64_t>(edit.new_end) - static_cast<int64_t>(edit.old_end);
+
+    // the old instructions parsed from the replaced tokens, the ones around them can't reach into the edit
+    auto first_origin_at = [&](size_t token) {
+        size_t lo = 0;
+        size_t hi = m_origins.size();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (m_origins[mid].first_token < token) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    };
+    const size_t first = first_origin_at(edit.first);
+    const size_t last = first_origin_at(edit.old_end);
+    if (first > 0 && m_origins[first - 1].end_token > edit.first) return false;
+    if (last > first && m_origins[last - 1].end_token > edit.old_end) return false;
+
+    Parser chunk{m_tokenizer};
+    chunk.m_quiet = true;
+    chunk.m_relocatable = true;
+    chunk.m_track_origins = true;
+    Section section = Section::Text;
+    auto it = tokens.begin() + edit.first;
+    const auto chunk_end = tokens.begin() + edit.new_end;
+    if (chunk.parse_statements(it, edit.new_end, chunk_end, section).is_error()) return false;
+    if (chunk.m_has_errored || it != chunk_end) return false;
+
+    const size_t added = chunk.m_instructions.size();
+    const uint32_t pc_begin = static_cast<uint32_t>(first * sizeof(uint32_t));
+    const int64_t pc_shift = (static_cast<int64_t>(added) - static_cast<int64_t>(last - first)) *
+                             static_cast<int64_t>(sizeof(uint32_t));
+
+    // labels: the replaced ones are dropped, the ones after the edit move with their tokens (and with their
+    // instructions, in the text section), the new ones take the place of the replaced ones
+    m_symbols.resize(m_tokenizer.symbols().size());
+    // the fixup lists point at instruction indices that are about to shift, from here on references are found
+    // through the origins instead
+    m_fixups.clear();
+    for (auto& info : m_symbols) {
+        info.first_fixup = SymbolInfo::no_fixup;
+    }
+    Vector<uint8_t> moved_symbols{};
+    moved_symbols.resize(m_symbols.size());
+    Vector<uint32_t> label_order{};
+    label_order.reserve(m_label_order.size() + chunk.m_local_labels.size());
+    size_t insert_at = m_label_order.size();
+    for (uint32_t id : m_label_order) {
+        auto& info = m_symbols[id];
+        if (info.token >= edit.first && insert_at == m_label_order.size()) insert_at = label_order.size();
+        if (info.token >= edit.first && info.token < edit.old_end) {
+            info.defined = false;
+            moved_symbols[id] = 1;
+            continue;
+        }
+        if (info.token >= edit.old_end) {
+            info.token = static_cast<uint32_t>(info.token + token_shift);
+            if (info.in_text && pc_shift != 0) {
+                info.address = static_cast<size_t>(static_cast<int64_t>(info.address) + pc_shift);
+                moved_symbols[id] = 1;
+            }
+        }
+        label_order.append(id);
+    }
+    if (insert_at > label_order.size()) insert_at = label_order.size();
+    Vector<uint32_t> new_labels{};
+    for (const auto& label : chunk.m_local_labels) {
+        const uint32_t id = tokens[label.token].symbol();
+        auto& info = m_symbols[id];
+        // redefinitions are reported by a full parse
+        if (info.defined) return false;
+        info.defined = true;
+        info.address = pc_begin + label.address;
+        info.token = label.token;
+        info.in_text = true;
+        moved_symbols[id] = 1;
+        new_labels.append(id);
+    }
+    m_label_order.clear();
+    m_label_order.reserve(label_order.size() + new_labels.size());
+    for (size_t i = 0; i < insert_at; ++i) {
+        m_label_order.append(label_order[i]);
+    }
+    for (uint32_t id : new_labels) {
+        m_label_order.append(id);
+    }
+    for (size_t i = insert_at; i < label_order.size(); ++i) {
+        m_label_order.append(label_order[i]);
+    }
+
+    // instructions and their origins
+    for (size_t k = first; k < last; ++k) {
+        if (m_instructions[k].has_symbol()) --m_unresolved;
+    }
+    Vector<IrInstruction> instructions{};
+    Vector<InstructionOrigin> origins{};
+    const size_t total = m_instructions.size() - (last - first) + added;
+    instructions.reserve(total);
+    origins.reserve(total);
+    for (size_t k = 0; k < first; ++k) {
+        instructions.append(m_instructions[k]);
+        origins.append(m_origins[k]);
+    }
+    for (size_t k = 0; k < added; ++k) {
+        IrInstruction insn = chunk.m_instructions[k];
+        insn.pc_address += pc_begin;
+        instructions.append(insn);
+        origins.append(chunk.m_origins[k]);
+    }
+    for (size_t k = last; k < m_instructions.size(); ++k) {
+        IrInstruction insn = m_instructions[k];
+        insn.pc_address = static_cast<uint32_t>(insn.pc_address + pc_shift);
+        InstructionOrigin origin = m_origins[k];
+        origin.first_token = static_cast<uint32_t>(origin.first_token + token_shift);
+        origin.end_token = static_cast<uint32_t>(origin.end_token + token_shift);
+        instructions.append(insn);
+        origins.append(origin);
+    }
+    m_instructions = move(instructions);
+    m_origins = move(origins);
+    current_pc = static_cast<uint32_t>(current_pc + pc_shift);
+
+    // re-resolve the references to labels that changed, an instruction only needs encoding again if its
+    // immediate or, for the pc-relative ones, its distance to the target changed
+    result = ReparseResult{first, last - first, added, {}};
+    for (size_t k = 0; k < m_instructions.size(); ++k) {
+        auto& insn = m_instructions[k];
+        const bool is_new = k >= first && k < first + added;
+        const bool moved = k >= first + added && pc_shift != 0;
+        const uint32_t symbol = m_origins[k].symbol;
+        const bool affected = symbol != Token::no_symbol && moved_symbols[symbol] != 0;
+        if (!is_new && !affected && !(moved && insn.is_pc_relative())) continue;
+        if (!is_new && insn.has_symbol()) --m_unresolved;
+        const IrInstruction before = insn;
+        if (symbol != Token::no_symbol) {
+            const auto& info = m_symbols[symbol];
+            if (info.defined) {
+                insn.set_immediate(static_cast<int32_t>(info.address));
+            } else {
+                insn.set_symbol(symbol);
+            }
+        }
+        if (insn.has_symbol()) ++m_unresolved;
+        if (!is_new && !insn.has_symbol() && !before.has_symbol()) {
+            // pc-relative words stay the same if the target moved exactly as far as the instruction
+            const int64_t imm_shift = static_cast<int64_t>(insn.imm - before.imm);
+            if (imm_shift == (insn.is_pc_relative() && moved ? pc_shift : 0)) continue;
+        }
+        result.dirty.append(static_cast<uint32_t>(k));
+    }
     return true;
 }
+
+// every span but the last is a whole page, so words never straddle two spans
+bool Parser::dump_binary_data() const {
+    if (current_address > SectionBuffer::max_size) { return false; }
+    Vector<OutputSpan> spans{};
+    m_data_section.for_each_span(current_address,
+                                 [&spans](const uint8_t* data, size_t size) { spans.append(OutputSpan{data, size}); });
+    return write_data_image(m_tokenizer.source_file(), spans.data(), spans.size());
+}
+String Parser::format_instruction(const IrInstruction& insn) const {
+    const auto& info = insn.info();
+    auto immediate = [&]() -> Immediate {
+        if (insn.has_symbol()) return Immediate{m_tokenizer.symbols().name(insn.symbol())};
+        if (insn.has_real_immediate()) return Immediate{insn.real_immediate()};
+        return Immediate{insn.immediate()};
+    };
+    String str = info.name.extract_string();
+    str += " "_s;
+    for (size_t i = 0; i < info.arg_count; ++i) {
+        if (i != 0) { str += ", "; }
+        switch (info.arg_types[i]) {
+        case ArgumentType::Reg:
+        case ArgumentType::Freg:
+            str += enum_to_str(insn.regs[i]);
+            break;
+        case ArgumentType::Imm:
+            str += PrintInfo<Immediate>(immediate()).repr();
+            break;
+        case ArgumentType::ImmWReg:
+            str += enum_to_str(insn.regs[i]) + "("_s + PrintInfo<Immediate>(immediate()).repr() + ")"_s;
+            break;
+        }
+    }
+    return str;
+}
 void Parser::dump_instructions() const {
     for (const auto& instruction : instructions()) {
         char buf[10]{};
         int ret = ARLib::snprintf(buf, sizeof(buf), "0x%04X: ", instruction.address());
         buf[ret] = '\0';
-        Printer::print("{}{}", StringView{buf}, instruction);
+        m_tokenizer.messages().print("{}{}", StringView{buf}, format_instruction(instruction));
     }
 }
 void Parser::dump_labels() const {
-    for (const auto& [name, value] : m_labels) {
-        Printer::print("{}: {}", name, value);
+    const auto& symbols = m_tokenizer.symbols();
+    for (uint32_t id : m_label_order) {
+        const Label label{symbols.name(id), m_symbols[id].address};
+        m_tokenizer.messages().print("{}: {}", label.name, label);
     }
 }
-void Parser::encode_instructions() const {
-    Path instruction_file = replace_extension(m_tokenizer.source_file(), FSCHAR(".cod"));
-    FILE* fp = fopen(instruction_file.string().data(), "w");
-    for (const auto& insn : m_instructions) {
-        ARLib::fprintf(fp, "%08x\n", insn.encode());
-    }
-    ARLib::fclose(fp);
+Vector<uint32_t> Parser::encode(const ThreadPool& pool) const {
+    constexpr size_t block_size = 16 * 1024;
+    Vector<uint32_t> words{};
+    words.resize(m_instructions.size());
+    const size_t blocks = (m_instructions.size() + block_size - 1) / block_size;
+    pool.parallel_for(blocks, [&](size_t i) {
+        const size_t first = i * block_size;
+        const size_t last = first + block_size < m_instructions.size() ? first + block_size : m_instructions.size();
+        for (size_t idx = first; idx < last; ++idx) {
+            words[idx] = m_instructions[idx].encode();
+        }
+    });
+    return words;
+}
+
+bool Parser::encode_instructions(bool binary) const {
+    ThreadPool serial{1};
+    return encode_instructions(serial, binary);
+}
+
+bool Parser::encode_instructions(const ThreadPool& pool, bool binary) const {
+    return write_instructions(pool, encode(pool), binary);
+}
+
+bool Parser::write_instructions(const ThreadPool& pool, const Vector<uint32_t>& words, bool binary) const {
+    return write_code_image(m_tokenizer.source_file(), pool, words.data(), words.size(), binary);
 }
\ No newline at end of file
@@ -1,7 +1,8 @@
 #pragma once
 #include "InstructionParser.h"
+#include "SectionBuffer.h"
+#include "ThreadPool.h"
 #include "Tokenizer.h"
-#include <FlatMap.hpp>
 #include <SSOVector.hpp>
 
 using namespace ARLib;
@@ -10,13 +11,64 @@ struct InstructionInfo;
 
 enum class Section { None, Data, Text };
 
+// Definition state of an interned symbol, references to it made before it's defined are kept in a list threaded
+// through Parser::m_fixups.
+struct SymbolInfo {
+    constexpr static uint32_t no_fixup = NumberTraits<uint32_t>::max;
+    size_t address = 0;
+    uint32_t first_fixup = no_fixup;
+    // index of the label token that defined it
+    uint32_t token = 0;
+    bool defined = false;
+    bool in_text = false;
+};
+
+struct Fixup {
+    uint32_t instruction;
+    uint32_t next;
+};
+
+struct LocalLabel {
+    uint32_t token;
+    size_t address;
+};
+
+// tokens [first_token, end_token) of an instruction and the symbol it references, if any
+struct InstructionOrigin {
+    uint32_t first_token;
+    uint32_t end_token;
+    uint32_t symbol;
+};
+
+// What an incremental re-parse changed: instructions [first, first + removed) were replaced by
+// [first, first + added), and every instruction listed in dirty (new indices) needs to be encoded again.
+struct ReparseResult {
+    size_t first = 0;
+    size_t removed = 0;
+    size_t added = 0;
+    Vector<uint32_t> dirty{};
+};
+
 class Parser {
-    static uint8_t m_ro_data[32768];
-    static uint8_t m_code_data[32768];
-    FlatMap<StringView, Label> m_labels;
-    Vector<InstructionData> m_instructions;
+    SectionBuffer m_data_section{};
+    // symbol ids of the labels, in definition order
+    Vector<uint32_t> m_label_order{};
+    // indexed by the symbol ids of the tokenizer
+    Vector<SymbolInfo> m_symbols{};
+    Vector<Fixup> m_fixups{};
+    size_t m_unresolved = 0;
+    Vector<IrInstruction> m_instructions;
+    // labels of a relocatable chunk, in definition order and relative to the start of the chunk
+    Vector<LocalLabel> m_local_labels{};
+    // one per instruction, only recorded when m_track_origins is set
+    Vector<InstructionOrigin> m_origins{};
     Tokenizer& m_tokenizer;
     bool m_has_errored = false;
+    bool m_quiet = false;
+    bool m_relocatable = false;
+    bool m_track_origins = false;
+    // the output also depends on files other than the source
+    bool m_includes_files = false;
     uint64_t current_address = 0;
     uint32_t current_pc = 0;
     bool assert_next_token(tit it, tit end, TokenKind kind, bool force_errors = true);
@@ -25,16 +77,49 @@ class Parser {
     tit parse_instruction(tit begin, tit end);
     tit parse_comma_separated_list(tit it, tit end, size_t value_size);
     bool assert_next_one_of(tit it, tit end, std::initializer_list<TokenKind> kinds);
+    void report(const StringView& error, const Token& tok);
+    void write_data(const Token& tok, uint64_t address, const void* data, size_t size);
+    void include_binary(const Token& tok);
+    String format_instruction(const IrInstruction& insn) const;
+    void define_label(uint32_t token, size_t address, Section section);
+    void add_label(uint32_t token, size_t address, Section section);
+    Section section_at(size_t token) const;
+    void reference_symbol(size_t instruction);
+    DiscardResult<> parse_statements(tit& it, size_t stop, tit end, Section& section);
+    StringView text(const Token& tok) const { return m_tokenizer.text(tok); }
 
     public:
-    Parser(Tokenizer& tokenizer) : m_tokenizer(tokenizer) {
-        memset(m_ro_data, 0, sizeof(m_ro_data));
-        memset(m_code_data, 0, sizeof(m_code_data));
-    }
+    Parser(Tokenizer& tokenizer) : m_tokenizer(tokenizer) {}
     DiscardResult<> parse();
+    DiscardResult<> parse(const ThreadPool& pool);
+    // prints the references to labels that were never defined
+    DiscardResult<> resolve_labels();
+    bool has_errors() const { return m_has_errored; }
+    bool has_unresolved_labels() const { return m_unresolved != 0; }
+    // forgets everything parsed so far, origins are recorded from the next parse on if track_origins is true
+    void reset(bool track_origins);
+    // Re-parses the tokens the tokenizer replaced in retokenize() and splices the result into the previous parse,
+    // shifting the instructions and labels after the edit. Returns false, leaving the parser in an unspecified
+    // state, if the edit can't be applied in place (it touches directives, doesn't parse cleanly on its own or
+    // redefines a label); the caller has to reset() and parse() again then.
+    bool reparse(const TokenEdit& edit, ReparseResult& result);
     const auto& instructions() const { return m_instructions; }
+    size_t label_count() const { return m_label_order.size(); }
+    uint64_t data_size() const { return current_address; }
+    bool includes_files() const { return m_includes_files; }
+    // calls func(const uint8_t* data, size_t size) on consecutive spans covering the data section
+    template <typename Func>
+    void for_each_data_span(Func&& func) const {
+        m_data_section.for_each_span(current_address, func);
+    }
     bool dump_binary_data() const;
     void dump_instructions() const;
     void dump_labels() const;
-    void encode_instructions() const;
+    // encoded words of every instruction, in order
+    Vector<uint32_t> encode(const ThreadPool& pool) const;
+    // hex text in <file>.cod, or native-endian words in <file>.cbin if binary is true
+    bool encode_instructions(bool binary = false) const;
+    bool encode_instructions(const ThreadPool& pool, bool binary = false) const;
+    // writes already encoded words the way encode_instructions() does
+    bool write_instructions(const ThreadPool& pool, const Vector<uint32_t>& words, bool binary) const;
 };
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+#include <Array.hpp>
+#include <StringView.hpp>
+#include <Types.hpp>
+
+using namespace ARLib;
+
+// Collision-free lookup table over a fixed set of names, built at compile time by searching for a hash seed that
+// gives every entry its own slot. A lookup is one hash, one slot load and one name comparison, and dotted names
+// (e.g. cvt.d.l) can be looked up from their separate pieces without joining them first.
+// Entry must have a StringView `name` member.
+template <typename Entry, size_t N, size_t M>
+class PerfectHashTable {
+    static_assert((M & (M - 1)) == 0, "table size must be a power of 2");
+    static_assert(N < 256, "slots are stored as uint8_t");
+    constexpr static uint32_t max_seed = 100000;
+    Array<Entry, N> m_entries{};
+    // index + 1 of the entry in each slot, 0 for empty slots
+    Array<uint8_t, M> m_slots{};
+    uint32_t m_seed = 0;
+
+    constexpr static uint32_t step(uint32_t h, char c) {
+        return (h ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    constexpr static uint32_t step(uint32_t h, StringView piece) {
+        for (size_t i = 0; i < piece.size(); ++i) {
+            h = step(h, piece[i]);
+        }
+        return h;
+    }
+    constexpr static size_t slot_of(uint32_t h) {
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        h ^= h >> 12;
+        return static_cast<size_t>(h & (M - 1));
+    }
+    constexpr bool try_seed(uint32_t seed) {
+        for (auto& slot : m_slots) {
+            slot = 0;
+        }
+        for (size_t i = 0; i < N; ++i) {
+            auto& slot = m_slots[slot_of(step(seed, m_entries[i].name))];
+            if (slot != 0) return false;
+            slot = static_cast<uint8_t>(i + 1);
+        }
+        return true;
+    }
+    // name == pieces joined by '.'
+    constexpr static bool matches(StringView name, const StringView* pieces, size_t count) {
+        size_t pos = 0;
+        for (size_t p = 0; p < count; ++p) {
+            if (p != 0) {
+                if (pos >= name.size() || name[pos] != '.') return false;
+                ++pos;
+            }
+            const auto piece = pieces[p];
+            if (name.size() - pos < piece.size()) return false;
+            for (size_t i = 0; i < piece.size(); ++i) {
+                if (name[pos + i] != piece[i]) return false;
+            }
+            pos += piece.size();
+        }
+        return pos == name.size();
+    }
+
+    public:
+    constexpr PerfectHashTable(const Array<Entry, N>& entries) : m_entries(entries) {
+        for (uint32_t seed = 2166136261u; seed < 2166136261u + max_seed; ++seed) {
+            if (try_seed(seed)) {
+                m_seed = seed;
+                return;
+            }
+        }
+    }
+    constexpr bool is_valid() const { return m_seed != 0; }
+    constexpr size_t size() const { return N; }
+    constexpr const auto& entries() const { return m_entries; }
+    constexpr const Entry* find(const StringView* pieces, size_t count) const {
+        uint32_t h = m_seed;
+        for (size_t p = 0; p < count; ++p) {
+            if (p != 0) h = step(h, '.');
+            h = step(h, pieces[p]);
+        }
+        const uint8_t slot = m_slots[slot_of(h)];
+        if (slot == 0) return nullptr;
+        const Entry& entry = m_entries[slot - 1];
+        return matches(entry.name, pieces, count) ? &entry : nullptr;
+    }
+    constexpr const Entry* find(StringView name) const { return find(&name, 1); }
+};
\ No newline at end of file
@@ -0,0 +1,200 @@
+#pragma once
+#include "Tokenizer.h"
+#include <Array.hpp>
+#include <Types.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ASQMIPS_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define ASQMIPS_HAS_AVX2 1
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace ARLib;
+
+namespace CharClass {
+    constexpr uint8_t Space = 1 << 0;
+    constexpr uint8_t Ident = 1 << 1;
+    constexpr uint8_t Number = 1 << 2;
+    constexpr uint8_t Separator = 1 << 3;
+} // namespace CharClass
+
+constexpr auto construct_char_classes() {
+    Array<uint8_t, 256> table{};
+    for (size_t c = 0; c < 256; ++c) {
+        uint8_t cls = 0;
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r') cls |= CharClass::Space;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '$')
+            cls |= CharClass::Ident;
+        if ((c >= '0' && c <= '9') || c == '.' || c == '-') cls |= CharClass::Number;
+        table[c] = cls;
+    }
+    for (const auto& sep : separators) {
+        table[static_cast<uint8_t>(sep.c)] |= CharClass::Separator;
+    }
+    return table;
+}
+
+constexpr auto construct_separator_kinds() {
+    Array<TokenKind, 256> table{};
+    for (size_t c = 0; c < 256; ++c) {
+        table[c] = TokenKind::Invalid;
+    }
+    for (const auto& sep : separators) {
+        table[static_cast<uint8_t>(sep.c)] = sep.t;
+    }
+    return table;
+}
+
+constexpr auto char_classes = construct_char_classes();
+constexpr auto separator_kinds = construct_separator_kinds();
+
+constexpr bool has_class(char c, uint8_t cls) {
+    return (char_classes[static_cast<uint8_t>(c)] & cls) != 0;
+}
+// TokenKind::Invalid if c is not a separator
+constexpr TokenKind separator_kind(char c) {
+    return separator_kinds[static_cast<uint8_t>(c)];
+}
+
+// Byte-at-a-time reference implementation, also used for the tails of the vectorized scans.
+struct ScalarScanner {
+    static const char* find_byte(const char* it, const char* end, char c) {
+        while (it != end && *it != c)
+            ++it;
+        return it;
+    }
+    // returns the end of the line starting at it, comment is set to the first ';' in the line (or the line end)
+    static const char* find_line_end(const char* it, const char* end, const char*& comment) {
+        while (it != end && *it != '\n' && *it != ';')
+            ++it;
+        comment = it;
+        if (it != end && *it == ';') it = find_byte(it, end, '\n');
+        return it;
+    }
+    static const char* skip_class(const char* it, const char* end, uint8_t cls) {
+        while (it != end && has_class(*it, cls))
+            ++it;
+        return it;
+    }
+    static const char* identifier_end(const char* it, const char* end) { return skip_class(it, end, CharClass::Ident); }
+    static const char* number_end(const char* it, const char* end) { return skip_class(it, end, CharClass::Number); }
+};
+
+#ifdef ASQMIPS_HAS_SSE2
+// Scans 16 (or 32 with AVX2) bytes per step, every function returns exactly what its ScalarScanner counterpart does.
+struct SimdScanner {
+    static uint32_t first_set_bit(uint32_t mask) {
+#ifdef _MSC_VER
+        unsigned long idx;
+        _BitScanForward(&idx, mask);
+        return static_cast<uint32_t>(idx);
+#else
+        return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+    }
+    // lanes where lo <= c <= hi
+    static __m128i in_range(__m128i v, char lo, char hi) {
+        const __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8(static_cast<char>(0x80 - lo)));
+        return _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(0x80 + (hi - lo + 1))));
+    }
+    static __m128i ident_mask(__m128i v) {
+        const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i mask = in_range(lower, 'a', 'z');
+        mask = _mm_or_si128(mask, in_range(v, '0', '9'));
+        mask = _mm_or_si128(mask, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+        return _mm_or_si128(mask, _mm_cmpeq_epi8(v, _mm_set1_epi8('$')));
+    }
+    static __m128i number_mask(__m128i v) {
+        __m128i mask = in_range(v, '0', '9');
+        mask = _mm_or_si128(mask, _mm_cmpeq_epi8(v, _mm_set1_epi8('.')));
+        return _mm_or_si128(mask, _mm_cmpeq_epi8(v, _mm_set1_epi8('-')));
+    }
+#ifdef ASQMIPS_HAS_AVX2
+    static __m256i in_range(__m256i v, char lo, char hi) {
+        const __m256i shifted = _mm256_add_epi8(v, _mm256_set1_epi8(static_cast<char>(0x80 - lo)));
+        return _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(0x80 + (hi - lo + 1))), shifted);
+    }
+    static __m256i ident_mask(__m256i v) {
+        const __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i mask = in_range(lower, 'a', 'z');
+        mask = _mm256_or_si256(mask, in_range(v, '0', '9'));
+        mask = _mm256_or_si256(mask, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+        return _mm256_or_si256(mask, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('$')));
+    }
+    static __m256i number_mask(__m256i v) {
+        __m256i mask = in_range(v, '0', '9');
+        mask = _mm256_or_si256(mask, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('.')));
+        return _mm256_or_si256(mask, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('-')));
+    }
+#endif
+    // first position where the lanes selected by MatchFn are set (or unset, if Negate)
+    template <bool Negate, typename MatchFn>
+    static const char* scan(const char* it, const char* end, MatchFn&& match) {
+#ifdef ASQMIPS_HAS_AVX2
+        while (end - it >= 32) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(match(v)));
+            if constexpr (Negate) mask = ~mask;
+            if (mask != 0) return it + first_set_bit(mask);
+            it += 32;
+        }
+#endif
+        while (end - it >= 16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+            uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(match(v)));
+            if constexpr (Negate) mask = ~mask & 0xFFFF;
+            if (mask != 0) return it + first_set_bit(mask);
+            it += 16;
+        }
+        return nullptr;
+    }
+    static const char* find_byte(const char* it, const char* end, char c) {
+        const char* found = scan<false>(it, end, [c](auto v) {
+            if constexpr (sizeof(v) == 16) {
+                return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+#ifdef ASQMIPS_HAS_AVX2
+            } else {
+                return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+#endif
+            }
+        });
+        if (found) return found;
+        return ScalarScanner::find_byte(end - ((end - it) % 16), end, c);
+    }
+    static const char* find_line_end(const char* it, const char* end, const char*& comment) {
+        const char* found = scan<false>(it, end, [](auto v) {
+            if constexpr (sizeof(v) == 16) {
+                return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8(';')));
+#ifdef ASQMIPS_HAS_AVX2
+            } else {
+                return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                                       _mm256_cmpeq_epi8(v, _mm256_set1_epi8(';')));
+#endif
+            }
+        });
+        if (!found) return ScalarScanner::find_line_end(end - ((end - it) % 16), end, comment);
+        comment = found;
+        if (*found == ';') return find_byte(found, end, '\n');
+        return found;
+    }
+    static const char* identifier_end(const char* it, const char* end) {
+        const char* found = scan<true>(it, end, [](auto v) { return ident_mask(v); });
+        if (found) return found;
+        return ScalarScanner::identifier_end(end - ((end - it) % 16), end);
+    }
+    static const char* number_end(const char* it, const char* end) {
+        const char* found = scan<true>(it, end, [](auto v) { return number_mask(v); });
+        if (found) return found;
+        return ScalarScanner::number_end(end - ((end - it) % 16), end);
+    }
+};
+using Scanner = SimdScanner;
+#else
+using Scanner = ScalarScanner;
+#endif
\ No newline at end of file
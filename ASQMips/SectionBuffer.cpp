@@ -0,0 +1,59 @@
+#include "SectionBuffer.h"
+
+uint8_t* PageArena::allocate_page() {
+    if (m_blocks.empty() || m_used_in_block == pages_per_block) {
+        Vector<uint8_t> block{};
+        block.resize(page_size * pages_per_block);
+        m_blocks.append(move(block));
+        m_used_in_block = 0;
+    }
+    uint8_t* page = m_blocks.last().data() + m_used_in_block * page_size;
+    ARLib::memset(page, 0, page_size);
+    ++m_used_in_block;
+    return page;
+}
+
+const uint8_t* SectionBuffer::zero_page() {
+    static const uint8_t zeroes[PageArena::page_size]{};
+    return zeroes;
+}
+
+uint8_t* SectionBuffer::page_for(uint64_t address) {
+    const size_t index = static_cast<size_t>(address / PageArena::page_size);
+    while (m_pages.size() <= index) {
+        m_pages.append(nullptr);
+    }
+    if (m_pages[index] == nullptr) m_pages[index] = m_arena.allocate_page();
+    return m_pages[index];
+}
+
+bool SectionBuffer::write(uint64_t address, const void* data, size_t size) {
+    if (address > max_size || size > max_size - address) return false;
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    const uint64_t end = address + size;
+    while (address < end) {
+        const size_t offset = static_cast<size_t>(address % PageArena::page_size);
+        size_t length = PageArena::page_size - offset;
+        if (length > end - address) length = static_cast<size_t>(end - address);
+        ARLib::memcpy(page_for(address) + offset, src, length);
+        src += length;
+        address += length;
+    }
+    if (end > m_high_water) m_high_water = end;
+    return true;
+}
+
+void SectionBuffer::read(uint64_t address, void* data, size_t size) const {
+    uint8_t* dst = static_cast<uint8_t*>(data);
+    const uint64_t end = address + size;
+    while (address < end) {
+        const size_t index = static_cast<size_t>(address / PageArena::page_size);
+        const size_t offset = static_cast<size_t>(address % PageArena::page_size);
+        size_t length = PageArena::page_size - offset;
+        if (length > end - address) length = static_cast<size_t>(end - address);
+        const uint8_t* page = index < m_pages.size() ? m_pages[index] : nullptr;
+        ARLib::memcpy(dst, page ? page + offset : zero_page() + offset, length);
+        dst += length;
+        address += length;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+#include <Types.hpp>
+#include <Vector.hpp>
+
+using namespace ARLib;
+
+// Hands out fixed-size zeroed pages carved from large blocks, pages live as long as the arena.
+class PageArena {
+    Vector<Vector<uint8_t>> m_blocks{};
+    size_t m_used_in_block = 0;
+
+    public:
+    constexpr static size_t page_size = 16 * 1024;
+    constexpr static size_t pages_per_block = 64;
+    PageArena() = default;
+    PageArena(const PageArena&) = delete;
+    PageArena& operator=(const PageArena&) = delete;
+    PageArena(PageArena&&) = default;
+    PageArena& operator=(PageArena&&) = default;
+    uint8_t* allocate_page();
+    size_t allocated_bytes() const { return m_blocks.size() * page_size * pages_per_block; }
+};
+
+// Growable, sparse byte image of a section. Pages are only allocated when something is written to them, so gaps
+// left by .org, .space or .align cost nothing, and unwritten bytes read back as zero.
+class SectionBuffer {
+    PageArena m_arena{};
+    // one entry per page up to the highest one written, nullptr if the page was never written
+    Vector<uint8_t*> m_pages{};
+    uint64_t m_high_water = 0;
+    uint8_t* page_for(uint64_t address);
+
+    public:
+    constexpr static uint64_t max_size = 1ull << 32;
+    SectionBuffer() = default;
+    SectionBuffer(const SectionBuffer&) = delete;
+    SectionBuffer& operator=(const SectionBuffer&) = delete;
+    SectionBuffer(SectionBuffer&&) = default;
+    SectionBuffer& operator=(SectionBuffer&&) = default;
+    // false if the write would go past max_size
+    bool write(uint64_t address, const void* data, size_t size);
+    bool write_byte(uint64_t address, uint8_t value) { return write(address, &value, 1); }
+    void read(uint64_t address, void* data, size_t size) const;
+    // one past the highest byte written
+    uint64_t high_water() const { return m_high_water; }
+    size_t allocated_bytes() const { return m_arena.allocated_bytes(); }
+    // calls func(const uint8_t* data, size_t size) on consecutive spans covering [0, size), holes are passed as
+    // spans of zeros
+    template <typename Func>
+    void for_each_span(uint64_t size, Func&& func) const {
+        for (uint64_t address = 0; address < size;) {
+            const size_t index = static_cast<size_t>(address / PageArena::page_size);
+            const size_t offset = static_cast<size_t>(address % PageArena::page_size);
+            size_t length = PageArena::page_size - offset;
+            if (length > size - address) length = static_cast<size_t>(size - address);
+            const uint8_t* page = index < m_pages.size() ? m_pages[index] : nullptr;
+            func(page ? page + offset : zero_page() + offset, length);
+            address += length;
+        }
+    }
+    static const uint8_t* zero_page();
+};
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "Stats.h"
+#include "Clock.h"
+#include <cstdio_compat.hpp>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#endif
+
+#ifdef _WIN32
+constexpr const char* memory_label = "committed";
+constexpr const char* current_label = "committed (current)";
+constexpr const char* peak_label = "committed (peak)";
+#else
+constexpr const char* memory_label = "heap";
+constexpr const char* current_label = "heap (current)";
+constexpr const char* peak_label = "heap (sampled max)";
+#endif
+
+uint64_t Stats::now_ns() {
+    return monotonic_ns();
+}
+
+MemoryUsage Stats::memory_usage() {
+    MemoryUsage usage{0, 0, 0};
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        usage.current = counters.PagefileUsage;
+        usage.peak = counters.PeakPagefileUsage;
+        usage.peak_rss = counters.PeakWorkingSetSize;
+    }
+#else
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    usage.current = info.uordblks + info.hblkhd;
+#elif defined(__GLIBC__)
+    struct mallinfo info = mallinfo();
+    usage.current = static_cast<size_t>(info.uordblks) + static_cast<size_t>(info.hblkhd);
+#endif
+    // glibc has no high-water mark for the heap, end_phase() keeps the largest sample
+    usage.peak = usage.current;
+    rusage ru{};
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+#ifdef __APPLE__
+        usage.peak_rss = static_cast<size_t>(ru.ru_maxrss);
+#else
+        usage.peak_rss = static_cast<size_t>(ru.ru_maxrss) * 1024;
+#endif
+    }
+#endif
+    return usage;
+}
+
+void Stats::end_phase(StringView name, uint64_t start_ns) {
+    uint64_t elapsed = now_ns() - start_ns;
+    auto usage = memory_usage();
+    if (usage.peak > m_peak_memory) m_peak_memory = usage.peak;
+    m_phases.append(Phase{name, elapsed, usage.current});
+}
+
+void Stats::set_counter(StringView name, uint64_t value) {
+    for (auto& counter : m_counters) {
+        if (counter.name == name) {
+            counter.value = value;
+            return;
+        }
+    }
+    m_counters.append(Counter{name, value});
+}
+
+uint64_t Stats::total_ns() const {
+    uint64_t total = 0;
+    for (const auto& phase : m_phases) {
+        total += phase.elapsed_ns;
+    }
+    return total;
+}
+
+static void print_line(const char* buf, int ret) {
+    if (ret <= 0) return;
+    Printer::print("{}", StringView{buf, static_cast<size_t>(ret)});
+}
+
+void Stats::report() const {
+    char buf[128]{};
+    auto usage = memory_usage();
+    size_t peak = usage.peak > m_peak_memory ? usage.peak : m_peak_memory;
+    Printer::print("---- statistics ----");
+    for (const auto& phase : m_phases) {
+        int ret = ARLib::snprintf(buf, sizeof(buf), "%-20.*s %12.3f ms  %s %10zu KiB",
+                                  static_cast<int>(phase.name.size()), phase.name.data(),
+                                  static_cast<double>(phase.elapsed_ns) / 1'000'000.0, memory_label,
+                                  phase.memory_after / 1024);
+        print_line(buf, ret);
+    }
+    int ret = ARLib::snprintf(buf, sizeof(buf), "%-20s %12.3f ms", "total",
+                              static_cast<double>(total_ns()) / 1'000'000.0);
+    print_line(buf, ret);
+    for (const auto& counter : m_counters) {
+        ret = ARLib::snprintf(buf, sizeof(buf), "%-20.*s %12llu", static_cast<int>(counter.name.size()),
+                              counter.name.data(), static_cast<unsigned long long>(counter.value));
+        print_line(buf, ret);
+    }
+    ret = ARLib::snprintf(buf, sizeof(buf), "%-20s %12zu KiB", current_label, usage.current / 1024);
+    print_line(buf, ret);
+    ret = ARLib::snprintf(buf, sizeof(buf), "%-20s %12zu KiB", peak_label, peak / 1024);
+    print_line(buf, ret);
+    ret = ARLib::snprintf(buf, sizeof(buf), "%-20s %12zu KiB", "rss (peak)", usage.peak_rss / 1024);
+    print_line(buf, ret);
+}
\ No newline at end of file
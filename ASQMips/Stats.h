@@ -0,0 +1,59 @@
+#pragma once
+#include <Printer.hpp>
+#include <StringView.hpp>
+#include <Types.hpp>
+#include <Vector.hpp>
+
+using namespace ARLib;
+
+// What the platform tells about the memory of the process. On Windows that's the commit charge, with a real
+// high-water mark. glibc only reports the heap in use, its peak is the current value and Stats keeps the largest
+// one seen at the end of a phase, so anything allocated and freed within a phase never shows up.
+struct MemoryUsage {
+    size_t current;
+    size_t peak;
+    size_t peak_rss;
+};
+
+class Stats {
+    struct Phase {
+        StringView name;
+        uint64_t elapsed_ns;
+        size_t memory_after;
+    };
+    struct Counter {
+        StringView name;
+        uint64_t value;
+    };
+    Vector<Phase> m_phases{};
+    Vector<Counter> m_counters{};
+    size_t m_peak_memory = 0;
+    void end_phase(StringView name, uint64_t start_ns);
+
+    public:
+    // RAII timer for a single pass, the elapsed time and the memory usage at its end are recorded on destruction.
+    class ScopedPhase {
+        Stats* m_stats;
+        StringView m_name;
+        uint64_t m_start_ns;
+
+        public:
+        ScopedPhase(Stats& stats, StringView name) : m_stats(&stats), m_name(name), m_start_ns(Stats::now_ns()) {}
+        ScopedPhase(const ScopedPhase&) = delete;
+        ScopedPhase& operator=(const ScopedPhase&) = delete;
+        ~ScopedPhase() { m_stats->end_phase(m_name, m_start_ns); }
+    };
+
+    Stats() = default;
+    ScopedPhase phase(StringView name) { return ScopedPhase{*this, name}; }
+    template <typename Func>
+    auto time(StringView name, Func&& func) {
+        ScopedPhase p{*this, name};
+        return func();
+    }
+    void set_counter(StringView name, uint64_t value);
+    uint64_t total_ns() const;
+    void report() const;
+    static uint64_t now_ns();
+    static MemoryUsage memory_usage();
+};
\ No newline at end of file
@@ -0,0 +1,59 @@
+#include "SymbolTable.h"
+
+uint32_t SymbolTable::hash(StringView name) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < name.size(); ++i) {
+        h = (h ^ static_cast<uint8_t>(name[i])) * 16777619u;
+    }
+    return h;
+}
+
+void SymbolTable::rehash(size_t capacity) {
+    m_slots.clear();
+    m_slots.reserve(capacity);
+    for (size_t i = 0; i < capacity; ++i) {
+        m_slots.append(0);
+    }
+    const size_t mask = capacity - 1;
+    for (size_t id = 0; id < m_names.size(); ++id) {
+        size_t slot = m_hashes[id] & mask;
+        while (m_slots[slot] != 0)
+            slot = (slot + 1) & mask;
+        m_slots[slot] = static_cast<uint32_t>(id + 1);
+    }
+}
+
+uint32_t SymbolTable::intern(StringView name) {
+    // keep the load factor under 1/2
+    if ((m_names.size() + 1) * 2 > m_slots.size()) rehash(m_slots.size() == 0 ? 256 : m_slots.size() * 2);
+    const uint32_t h = hash(name);
+    const size_t mask = m_slots.size() - 1;
+    size_t slot = h & mask;
+    while (m_slots[slot] != 0) {
+        const uint32_t id = m_slots[slot] - 1;
+        if (m_hashes[id] == h && m_names[id] == name) return id;
+        slot = (slot + 1) & mask;
+    }
+    const uint32_t id = static_cast<uint32_t>(m_names.size());
+    m_names.append(name);
+    m_hashes.append(h);
+    m_slots[slot] = id + 1;
+    return id;
+}
+
+uint32_t SymbolTable::find(StringView name) const {
+    if (m_slots.size() == 0) return NumberTraits<uint32_t>::max;
+    const uint32_t h = hash(name);
+    const size_t mask = m_slots.size() - 1;
+    for (size_t slot = h & mask; m_slots[slot] != 0; slot = (slot + 1) & mask) {
+        const uint32_t id = m_slots[slot] - 1;
+        if (m_hashes[id] == h && m_names[id] == name) return id;
+    }
+    return NumberTraits<uint32_t>::max;
+}
+
+void SymbolTable::clear() {
+    m_names.clear();
+    m_hashes.clear();
+    m_slots.clear();
+}
\ No newline at end of file
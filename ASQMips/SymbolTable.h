@@ -0,0 +1,29 @@
+#pragma once
+#include <StringView.hpp>
+#include <Types.hpp>
+#include <Vector.hpp>
+
+using namespace ARLib;
+
+// Interns identifier names to dense ids, in order of first appearance. Names are views into the source and are
+// not copied.
+class SymbolTable {
+    Vector<StringView> m_names{};
+    Vector<uint32_t> m_hashes{};
+    // id + 1 of the symbol in each slot, 0 for empty slots
+    Vector<uint32_t> m_slots{};
+    static uint32_t hash(StringView name);
+    void rehash(size_t capacity);
+
+    public:
+    SymbolTable() = default;
+    uint32_t intern(StringView name);
+    // NumberTraits<uint32_t>::max if the name was never interned
+    uint32_t find(StringView name) const;
+    StringView name(uint32_t id) const { return m_names[id]; }
+    // points the symbol at another copy of the same name, e.g. after the source it was viewing moved
+    void rebind(uint32_t id, StringView name) { m_names[id] = name; }
+    size_t size() const { return m_names.size(); }
+    const Vector<StringView>& names() const { return m_names; }
+    void clear();
+};
\ No newline at end of file
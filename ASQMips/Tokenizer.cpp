@@ -1,181 +1,436 @@
 #include "Tokenizer.h"
 #include "DirectiveParser.h"
-#include <CxprHashMap.hpp>
+#include "Scanner.h"
+#include "Stats.h"
+#include <cstdio_compat.hpp>
 
 DiscardResult<FileError> Tokenizer::open() {
+    if (auto res = m_mapping.map(m_file.name()); !res.is_error()) {
+        m_sources.append(SourceFile{m_source_file, m_mapping.view()});
+        return {};
+    }
+    // not something we can map (e.g. a pipe), fall back to reading the whole file
     TRY(m_file.open(OpenFileMode::Read));
+    auto contents_or_err = m_file.read_all();
+    if (contents_or_err.is_error()) { return contents_or_err.to_error(); }
+    m_buffer = contents_or_err.to_ok();
+    m_sources.append(SourceFile{m_source_file, m_buffer.view()});
     return {};
 }
 
-static StringView from_iter(ConstIterator<char> it, ConstIterator<char> end) {
-    return StringView{&*it, &*end};
+static StringView trim_view(const char* begin, const char* end) {
+    while (begin != end && has_class(*begin, CharClass::Space))
+        ++begin;
+    while (end != begin && has_class(*(end - 1), CharClass::Space))
+        --end;
+    if (begin == end) return StringView{};
+    return StringView{begin, end};
 }
-using itt = ConstIterator<char>;
 
-static auto is_separator(char c) {
-    return find_if(separators, [c](const Sep& s) { return c == s.c; });
+// a number run ends at the second decimal divider, dot_n is the number of dividers seen (2 meaning an error)
+template <typename ScannerT>
+static const char* go_until_valid_number(const char* it, const char* end, uint8_t& dot_n) {
+    const char* run_end = ScannerT::number_end(it, end);
+    const char* first_dot = ScannerT::find_byte(it, run_end, '.');
+    if (first_dot == run_end) return run_end;
+    dot_n = 1;
+    const char* second_dot = ScannerT::find_byte(first_dot + 1, run_end, '.');
+    if (second_dot == run_end) return run_end;
+    dot_n = 2;
+    return second_dot;
 }
 
-static bool is_valid_identifier(const char c) {
-    if (!(isalnum(c) || c == '_' || c == '$')) return false;
-    return true;
-}
-static bool is_valid_identifier(StringView word) {
-    for (char c : word) {
-        if (!is_valid_identifier(c)) { return false; }
-    }
-    return true;
-}
-static auto go_until_valid_ident(itt it, itt end) {
-    if (it == end) return it;
-    while (!(isspace(*it) || is_separator(*it) != npos_) && is_valid_identifier(*it)) {
+// characters that can't start any token, consumed as a single invalid word
+static const char* go_until_valid_token(const char* it, const char* end) {
+    while (it != end && !has_class(*it, CharClass::Space | CharClass::Separator | CharClass::Ident | CharClass::Number))
         ++it;
-        if (it == end) return it;
-    }
     return it;
 }
 
-static auto go_until_valid_number(itt it, itt end, uint8_t& dot_n) {
-
-    auto is_valid_sep_for_number = [](itt it) {
-        auto idx = is_separator(*it);
-        if (idx != npos_ && separators[idx].t != TokenKind::Dot) return true;
-        return false;
-    };
-
-    if (it == end) return it;
-    while (!(isspace(*it) || is_valid_sep_for_number(it)) && (isdigit(*it) || *it == '.' || *it == '-')) {
-        if (*it == '.') {
-            if (dot_n) {
-                dot_n++;
-                return it;
-            };
-            dot_n++;
-        }
-        ++it;
-        if (it == end) return it;
-    }
-    return it;
-}
-
-TokenizeResult Tokenizer::tokenize() {
+// returns true if any error was found, errors are only printed if quiet is false
+template <typename ScannerT>
+bool Tokenizer::tokenize_range(const char* range_begin, const char* range_end, Vector<Token>& tokens,
+                               SymbolTable& symbols, bool quiet) const {
     bool has_errored = false;
-    auto lines_or_err = m_file.read_all();
-    if (lines_or_err.is_error()) { return TokenizeError{lines_or_err.to_error()}; }
-    m_lines = lines_or_err.to_ok()
-              .split("\n")
-              .iter()
-              .inplace_transform([](String& line) { return line.trim(); })
-              .collect<Vector<String>>();
-    for (const auto& [i, line] : m_lines.enumerate()) {
-        if (line.is_empty()) continue;
-        auto comment_pos = line.index_of(';');
-        StringView real_line{};
-        if (comment_pos != StringView::npos) {
-            real_line = line.substringview(0, comment_pos);
-        } else {
-            real_line = line.view();
+    constexpr uint8_t file_id = 0;
+    const char* const source_begin = m_sources[file_id].text.data();
+    auto make_token = [&](const char* first, const char* last, TokenKind kind) {
+        return Token{static_cast<uint32_t>(first - source_begin), static_cast<uint32_t>(last - first), kind, file_id};
+    };
+    auto report = [&](const StringView& error, const Token& tok) {
+        if (!quiet) print_error(error, tok);
+        has_errored = true;
+    };
+    for (const char* line_begin = range_begin; line_begin < range_end;) {
+        const char* comment_pos = nullptr;
+        const char* line_end = ScannerT::find_line_end(line_begin, range_end, comment_pos);
+        const StringView real_line = trim_view(line_begin, comment_pos);
+        line_begin = line_end == range_end ? range_end : line_end + 1;
+        if (real_line.is_empty()) continue;
+        const char* it = real_line.data();
+        const char* const end = it + real_line.size();
+        // no token can be longer than its line
+        if (real_line.size() > Token::max_length) {
+            report("line is too long"_sv, make_token(it, it, TokenKind::Invalid));
+            continue;
         }
-        auto begin = real_line.begin();
-        auto end = real_line.end();
-        auto it = begin;
         while (it != end) {
-            while (isspace(*it))
+            while (it != end && has_class(*it, CharClass::Space))
                 ++it;
             if (it == end) break;
-            if (auto idx = is_separator(*it); idx != npos_) {
-                auto sep = separators[idx];
-                if (sep.t == TokenKind::Quote) {
+            if (auto kind = separator_kind(*it); kind != TokenKind::Invalid) {
+                if (kind == TokenKind::Quote) {
                     ++it;
-                    auto next_quote = advance_iterator(it, end, find(it, end, '"'));
-                    auto tok =
-                    Token{from_iter(it, next_quote), TokenKind::String, m_source_file.string().view(), i, it - begin};
-                    if (next_quote == end) {
-                        print_error("unterminated string"_sv, tok);
-                        has_errored = true;
-                    }
-                    m_tokens.append(move(tok));
+                    auto next_quote = ScannerT::find_byte(it, end, '"');
+                    auto tok = make_token(it, next_quote, TokenKind::String);
+                    if (next_quote == end) { report("unterminated string"_sv, tok); }
+                    tokens.append(move(tok));
                     it = next_quote;
-                } else if (sep.t == TokenKind::Apostrophe) {
+                } else if (kind == TokenKind::Apostrophe) {
                     ++it;
-                    auto next_apost = advance_iterator(it, end, find(it, end, '\''));
-                    auto tok =
-                    Token{from_iter(it, next_apost), TokenKind::Char, m_source_file.string().view(), i, it - begin};
+                    auto next_apost = ScannerT::find_byte(it, end, '\'');
+                    auto tok = make_token(it, next_apost, TokenKind::Char);
                     if (next_apost == end || (next_apost - it) != 1) {
-                        print_error("unterminated character literal"_sv, tok);
-                        has_errored = true;
+                        report("unterminated character literal"_sv, tok);
                     }
-                    m_tokens.append(move(tok));
+                    tokens.append(move(tok));
                     it = next_apost;
                 } else {
-                    auto tok = Token{from_iter(it, it + 1), sep.t, m_source_file.string().view(), i, it - begin};
+                    auto tok = make_token(it, it + 1, kind);
                     if (tok.kind() == TokenKind::Colon) {
-                        if (m_tokens.empty()) {
-                            print_error("unexpected colon without previous tokens"_sv, tok);
-                            has_errored = true;
-                        }
-                        auto& prev = m_tokens.last();
-                        if (prev.kind() == TokenKind::Identifier) {
+                        if (tokens.empty()) {
+                            report("unexpected colon without previous tokens"_sv, tok);
+                        } else if (auto& prev = tokens.last(); prev.kind() == TokenKind::Identifier) {
                             prev.set_as_label();
                         } else {
-                            print_error("unexpected colon after token"_sv, tok);
-                            has_errored = true;
+                            report("unexpected colon after token"_sv, tok);
                         }
                     }
-                    m_tokens.append(tok);
+                    tokens.append(tok);
                 }
                 if (it != end) ++it;
-            } else if (isdigit(*it) || *it == '-') {
+            } else if (has_class(*it, CharClass::Number) && *it != '.') {
                 uint8_t dot_n = 0;
-                auto end_of_digit = go_until_valid_number(it, end, dot_n);
-                auto tok = Token{from_iter(it, end_of_digit), dot_n == 0 ? TokenKind::Integer : TokenKind::Real,
-                                 m_source_file.string().view(), i, it - begin};
-                if (*it == '-' && end_of_digit == it + 1) {
-                    print_error("lone - found"_sv, tok);
-                    has_errored = true;
-                }
-                m_tokens.append(move(tok));
+                auto end_of_digit = go_until_valid_number<ScannerT>(it, end, dot_n);
+                auto tok = make_token(it, end_of_digit, dot_n == 0 ? TokenKind::Integer : TokenKind::Real);
+                if (*it == '-' && end_of_digit == it + 1) { report("lone - found"_sv, tok); }
+                tokens.append(move(tok));
                 if (dot_n > 1) {
-                    print_error("unexpected second decimal divider while parsing floating point number",
-                                m_tokens.last());
-                    has_errored = true;
+                    report("unexpected second decimal divider while parsing floating point number", tokens.last());
                 }
                 it = end_of_digit;
-            } else {
-                auto end_of_token = go_until_valid_ident(it, end);
-                const auto word = from_iter(it, end_of_token);
+            } else if (has_class(*it, CharClass::Ident)) {
+                auto end_of_token = ScannerT::identifier_end(it, end);
+                const auto word = StringView{it, end_of_token};
 
                 // check if token is a directive
-                if (auto dir_it = is_directive(word); dir_it != directive_map.end()) {
-                    if (m_tokens.last().kind() == TokenKind::Dot) {
-                        m_tokens.emplace(word, TokenKind::Directive, m_source_file.string().view(), i, it - begin);
-                    } else {
-                        m_tokens.emplace(word, TokenKind::Identifier, m_source_file.string().view(), i, it - begin);
-                    }
+                const bool after_dot = !tokens.empty() && tokens.last().kind() == TokenKind::Dot;
+                if (after_dot && is_directive(word) != nullptr) {
+                    tokens.append(make_token(it, end_of_token, TokenKind::Directive));
                 } else {
-                    bool valid = is_valid_identifier(word);
-                    m_tokens.emplace(word, valid ? TokenKind::Identifier : TokenKind::Invalid,
-                                     m_source_file.string().view(), i, it - begin);
-                    const auto& tok = m_tokens.last();
-                    if (!valid) {
-                        print_error("invalid identifier token", tok);
-                        has_errored = true;
+                    auto tok = make_token(it, end_of_token, TokenKind::Identifier);
+                    const uint32_t symbol = symbols.intern(word);
+                    if (symbol >= Token::no_symbol) {
+                        report("too many distinct identifiers"_sv, tok);
+                    } else {
+                        tok.set_symbol(symbol);
                     }
+                    tokens.append(move(tok));
                 }
                 it = end_of_token;
+            } else {
+                auto end_of_token = go_until_valid_token(it, end);
+                tokens.append(make_token(it, end_of_token, TokenKind::Invalid));
+                report("invalid identifier token", tokens.last());
+                it = end_of_token;
             }
         }
     }
-    if (has_errored) { return TokenizeError{"Error during tokenization"_s}; }
+    return has_errored;
+}
+
+TokenizeResult Tokenizer::tokenize() {
+    return tokenize_with<Scanner>();
+}
+
+template <typename ScannerT>
+TokenizeResult Tokenizer::tokenize_with() {
+    m_tokens.clear();
+    m_chunk_starts.clear();
+    m_symbols.clear();
+    m_detached_names.clear();
+    const StringView source = m_sources[0].text;
+    if (source.size() > NumberTraits<uint32_t>::max) { return TokenizeError{"Source file is too big"_s}; }
+    if (tokenize_range<ScannerT>(source.data(), source.data() + source.size(), m_tokens, m_symbols, false)) {
+        return TokenizeError{"Error during tokenization"_s};
+    }
     return {};
 }
 
+TokenizeResult Tokenizer::tokenize(const ThreadPool& pool) {
+    constexpr size_t min_chunk_size = 64 * 1024;
+    const StringView source = m_sources[0].text;
+    if (source.size() > NumberTraits<uint32_t>::max) { return TokenizeError{"Source file is too big"_s}; }
+    size_t chunk_count = source.size() / min_chunk_size;
+    if (chunk_count > pool.size() * 4) chunk_count = pool.size() * 4;
+    if (pool.size() <= 1 || chunk_count < 2) return tokenize();
+    const char* const source_begin = source.data();
+    const char* const source_end = source_begin + source.size();
+
+    // chunks always start at the beginning of a line
+    Vector<const char*> bounds{};
+    bounds.append(source_begin);
+    for (size_t i = 1; i < chunk_count; ++i) {
+        const char* split = source_begin + source.size() / chunk_count * i;
+        if (split < bounds.last()) split = bounds.last();
+        split = Scanner::find_byte(split, source_end, '\n');
+        if (split == source_end) break;
+        if (split + 1 > bounds.last()) bounds.append(split + 1);
+    }
+    bounds.append(source_end);
+    const size_t chunks = bounds.size() - 1;
+
+    Vector<Vector<Token>> parts{};
+    Vector<SymbolTable> part_symbols{};
+    Vector<uint8_t> errored{};
+    parts.resize(chunks);
+    part_symbols.resize(chunks);
+    errored.resize(chunks);
+    pool.parallel_for(chunks, [&](size_t i) {
+        errored[i] = tokenize_range<Scanner>(bounds[i], bounds[i + 1], parts[i], part_symbols[i], true) ? 1 : 0;
+    });
+    // the serial tokenizer reports the errors in source order
+    for (size_t i = 0; i < chunks; ++i) {
+        if (errored[i]) return tokenize();
+    }
+
+    size_t total = 0;
+    for (const auto& part : parts) {
+        total += part.size();
+    }
+    m_tokens.clear();
+    m_chunk_starts.clear();
+    m_symbols.clear();
+    m_detached_names.clear();
+    m_tokens.reserve(total);
+    Vector<uint32_t> remap{};
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        // interning the chunk's names in chunk order gives every name the id the serial tokenizer would
+        auto& part = parts[chunk];
+        remap.clear();
+        for (const auto& name : part_symbols[chunk].names()) {
+            const uint32_t symbol = m_symbols.intern(name);
+            if (symbol >= Token::no_symbol) return tokenize();
+            remap.append(symbol);
+        }
+        for (auto& tok : part) {
+            if (tok.has_symbol()) tok.set_symbol(remap[tok.symbol()]);
+        }
+        if (part.empty()) continue;
+        // a directive name at the start of a chunk can't see the dot that ends the previous one
+        const Token& first = part[0];
+        if (!m_tokens.empty() && m_tokens.last().kind() == TokenKind::Dot && first.kind() == TokenKind::Identifier &&
+            is_directive(text(first)) != nullptr) {
+            m_chunk_starts.append(static_cast<uint32_t>(m_tokens.size()));
+            Token directive = first;
+            directive.set_as_directive();
+            m_tokens.append(directive);
+            for (size_t i = 1; i < part.size(); ++i) {
+                m_tokens.append(part[i]);
+            }
+            continue;
+        }
+        m_chunk_starts.append(static_cast<uint32_t>(m_tokens.size()));
+        for (const auto& tok : part) {
+            m_tokens.append(tok);
+        }
+    }
+    return {};
+}
+
+void Tokenizer::load(String text) {
+    m_mapping.unmap();
+    m_buffer = move(text);
+    m_sources.clear();
+    m_sources.append(SourceFile{m_source_file, m_buffer.view()});
+    m_tokens.clear();
+    m_chunk_starts.clear();
+}
+
+TokenizeResult Tokenizer::retokenize(String text, size_t begin, size_t old_end, size_t new_end, TokenEdit& edit) {
+    if (text.size() > NumberTraits<uint32_t>::max) { return TokenizeError{"Source file is too big"_s}; }
+    const StringView old_source = m_sources[0].text;
+    const char* const old_base = old_source.data();
+    const int64_t shift = static_cast<int64_t>(new_end) - static_cast<int64_t>(old_end);
+    auto first_token_at = [&](size_t offset) {
+        size_t lo = 0;
+        size_t hi = m_tokens.size();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (m_tokens[mid].offset() < offset) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    };
+    const size_t first = first_token_at(begin);
+    const size_t old_stop = first_token_at(old_end);
+
+    // the old source has to stay alive until the symbol names viewing it are moved over
+    String old_buffer = move(m_buffer);
+    MappedFile old_mapping = move(m_mapping);
+    m_buffer = move(text);
+    m_sources[0].text = m_buffer.view();
+    m_sources[0].line_starts.clear();
+    const char* const new_base = m_sources[0].text.data();
+    for (uint32_t id = 0; id < m_symbols.size(); ++id) {
+        const StringView name = m_symbols.name(id);
+        if (name.data() < old_base || name.data() >= old_base + old_source.size()) continue;
+        const size_t offset = static_cast<size_t>(name.data() - old_base);
+        if (offset < begin) {
+            m_symbols.rebind(id, StringView{new_base + offset, name.size()});
+        } else if (offset >= old_end) {
+            m_symbols.rebind(id, StringView{new_base + static_cast<int64_t>(offset) + shift, name.size()});
+        } else {
+            Vector<char> copy{};
+            copy.resize(name.size());
+            ARLib::memcpy(copy.data(), name.data(), name.size());
+            m_symbols.rebind(id, StringView{copy.data(), copy.size()});
+            m_detached_names.append(move(copy));
+        }
+    }
+
+    Vector<Token> fresh{};
+    if (tokenize_range<Scanner>(new_base + begin, new_base + new_end, fresh, m_symbols, true)) {
+        TRY(tokenize());
+        edit = TokenEdit{0, 0, m_tokens.size(), false};
+        return {};
+    }
+    auto is_plain = [](const Token& tok) {
+        return tok.kind() != TokenKind::Dot && tok.kind() != TokenKind::Directive;
+    };
+    bool plain = first == 0 || m_tokens[first - 1].kind() != TokenKind::Dot;
+    // a colon opening either side would turn the identifier before the edit into a label
+    if (old_stop > first && m_tokens[first].kind() == TokenKind::Colon) plain = false;
+    if (!fresh.empty() && fresh[0].kind() == TokenKind::Colon) plain = false;
+    if (old_stop < m_tokens.size() && m_tokens[old_stop].kind() == TokenKind::Colon) plain = false;
+    for (size_t i = first; i < old_stop && plain; ++i) {
+        plain = is_plain(m_tokens[i]);
+    }
+    for (size_t i = 0; i < fresh.size() && plain; ++i) {
+        plain = is_plain(fresh[i]);
+    }
+
+    Vector<Token> tokens{};
+    tokens.reserve(m_tokens.size() - (old_stop - first) + fresh.size());
+    for (size_t i = 0; i < first; ++i) {
+        tokens.append(m_tokens[i]);
+    }
+    for (const auto& tok : fresh) {
+        tokens.append(tok);
+    }
+    for (size_t i = old_stop; i < m_tokens.size(); ++i) {
+        const Token& tok = m_tokens[i];
+        tokens.append(Token{static_cast<uint32_t>(tok.offset() + shift), tok.length(), tok.kind(), tok.file_id(),
+                            tok.symbol()});
+    }
+    m_tokens = move(tokens);
+    m_chunk_starts.clear();
+    edit = TokenEdit{first, old_stop, first + fresh.size(), plain};
+    return {};
+}
+
+static void print_throughput(const char* name, size_t bytes, size_t iterations, uint64_t elapsed_ns) {
+    char buf[128]{};
+    double seconds = static_cast<double>(elapsed_ns) / 1'000'000'000.0;
+    double mib = static_cast<double>(bytes) * static_cast<double>(iterations) / (1024.0 * 1024.0);
+    int ret = ARLib::snprintf(buf, sizeof(buf), "%-20s %8zu runs %12.3f ms %10.2f MiB/s", name, iterations,
+                              seconds * 1000.0, seconds > 0 ? mib / seconds : 0.0);
+    if (ret > 0) Printer::print("{}", StringView{buf, static_cast<size_t>(ret)});
+}
+
+template <typename ScannerT>
+bool Tokenizer::bench_with(const char* name) {
+    constexpr uint64_t min_duration_ns = 500'000'000;
+    constexpr size_t min_iterations = 5;
+    const size_t bytes = m_sources[0].text.size();
+    size_t iterations = 0;
+    uint64_t start = Stats::now_ns();
+    uint64_t elapsed = 0;
+    do {
+        if (tokenize_with<ScannerT>().is_error()) return false;
+        ++iterations;
+        elapsed = Stats::now_ns() - start;
+    } while (iterations < min_iterations || elapsed < min_duration_ns);
+    print_throughput(name, bytes, iterations, elapsed);
+    return true;
+}
+
+TokenizeResult Tokenizer::bench_lexer() {
+    Printer::print("---- lexer benchmark ({} bytes) ----", m_sources[0].text.size());
+    if (!bench_with<ScalarScanner>("scalar")) { return TokenizeError{"Error during tokenization"_s}; }
+#ifdef ASQMIPS_HAS_AVX2
+    if (!bench_with<SimdScanner>("simd (avx2)")) { return TokenizeError{"Error during tokenization"_s}; }
+#elif defined(ASQMIPS_HAS_SSE2)
+    if (!bench_with<SimdScanner>("simd (sse2)")) { return TokenizeError{"Error during tokenization"_s}; }
+#endif
+    return tokenize();
+}
+
+void SourceFile::build_line_starts() const {
+    if (!line_starts.empty()) return;
+    line_starts.append(0);
+    for (size_t off = 0; off < text.size(); ++off) {
+        if (text[off] == '\n') line_starts.append(static_cast<uint32_t>(off + 1));
+    }
+}
+
+SourceLocation SourceFile::location(uint32_t offset) const {
+    build_line_starts();
+    // last line starting at or before offset
+    size_t lo = 0;
+    size_t hi = line_starts.size();
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (line_starts[mid] <= offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    // columns count from the trimmed line, the one line() returns
+    uint32_t line_begin = line_starts[lo];
+    while (line_begin < offset && has_class(text[line_begin], CharClass::Space))
+        ++line_begin;
+    return SourceLocation{lo, offset - line_begin};
+}
+
+StringView SourceFile::line(size_t line) const {
+    build_line_starts();
+    if (line >= line_starts.size()) return StringView{};
+    const char* begin = text.data() + line_starts[line];
+    const char* end =
+    line + 1 < line_starts.size() ? text.data() + line_starts[line + 1] - 1 : text.data() + text.size();
+    return trim_view(begin, end);
+}
+
+String Tokenizer::describe(const Token& tok) const {
+    const auto& src = source(tok);
+    auto loc = src.location(tok.offset());
+    return Printer::format("Token {{ {} \"{}\", in {} at {}:{} }}", enum_to_str_view(tok.kind()), src.view(tok),
+                           src.path.string().view(), loc.line + 1, loc.column);
+}
+
 void Tokenizer::print_error(const StringView& error, const Token& tok) const {
-    Printer::print("error: {} at {} (full line: {})", error, tok, m_lines[tok.line()]);
+    const auto& src = source(tok);
+    m_messages.print("error: {} at {} (full line: {})", error, describe(tok),
+                     src.line(src.location(tok.offset()).line));
 }
 
 void Tokenizer::dump_tokens() const {
     for (const auto& tok : m_tokens) {
-        Printer::print("{}", tok);
+        m_messages.print("{}", describe(tok));
     }
 }
\ No newline at end of file
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "MappedFile.h"
+#include "MessageSink.h"
+#include "SymbolTable.h"
+#include "ThreadPool.h"
 #include <Array.hpp>
 #include <CharConv.hpp>
 #include <EnumHelpers.hpp>
@@ -26,42 +30,54 @@ constexpr Array separators{Sep{':', TokenKind::Colon},       Sep{',', TokenKind:
                            Sep{')', TokenKind::CloseParens}, Sep{'"', TokenKind::Quote},
                            Sep{'\'', TokenKind::Apostrophe}};
 
+// Tokens only carry where they are in their source file, the text and the line/column are looked up through the
+// Tokenizer that produced them. Identifiers and labels also carry the id their name was interned to.
 class Token {
-    StringView m_token;
-    TokenKind m_kind;
-    FsStringView m_source_file;
-    size_t m_line;
-    size_t m_column;
+    uint32_t m_offset;
+    uint32_t m_length : 24;
+    uint32_t m_kind : 8;
+    uint32_t m_symbol : 24;
+    uint32_t m_file_id : 8;
 
     public:
+    constexpr static uint32_t max_length = (1u << 24) - 1;
+    constexpr static uint32_t no_symbol = (1u << 24) - 1;
     constexpr Token() noexcept = default;
-    constexpr Token(const StringView& token, TokenKind kind, const FsStringView& source_file, size_t line,
-                    size_t column) noexcept :
-        m_token(token), m_kind(kind), m_source_file(source_file), m_line(line), m_column(column) {}
-    constexpr Token(const Token&) noexcept = default;
-    constexpr Token(Token&&) noexcept = default;
-    constexpr Token& operator=(const Token& o) noexcept {
-        m_token = o.token();
-        m_kind = o.kind();
-        m_source_file = o.source_file();
-        m_line = o.line();
-        m_column = o.column();
-        return *this;
+    constexpr Token(uint32_t offset, uint32_t length, TokenKind kind, uint8_t file_id,
+                    uint32_t symbol = no_symbol) noexcept :
+        m_offset(offset), m_length(length), m_kind(ToUnderlying(kind)), m_symbol(symbol), m_file_id(file_id) {}
+    constexpr uint32_t offset() const noexcept { return m_offset; }
+    constexpr uint32_t length() const noexcept { return m_length; }
+    constexpr TokenKind kind() const noexcept { return static_cast<TokenKind>(m_kind); }
+    constexpr uint8_t file_id() const noexcept { return static_cast<uint8_t>(m_file_id); }
+    constexpr uint32_t symbol() const noexcept { return m_symbol; }
+    constexpr bool has_symbol() const noexcept { return m_symbol != no_symbol; }
+    constexpr void set_symbol(uint32_t symbol) noexcept { m_symbol = symbol; }
+    constexpr void set_as_label() noexcept { m_kind = ToUnderlying(TokenKind::Label); }
+    constexpr void set_as_directive() noexcept {
+        m_kind = ToUnderlying(TokenKind::Directive);
+        m_symbol = no_symbol;
     }
-    constexpr Token& operator=(Token&& o) noexcept {
-        m_token = move(o.token());
-        m_kind = o.kind();
-        m_source_file = move(o.source_file());
-        m_line = o.line();
-        m_column = o.column();
-        return *this;
+};
+static_assert(sizeof(Token) <= 12, "Token should stay compact");
+
+struct SourceLocation {
+    size_t line;
+    size_t column;
+};
+
+struct SourceFile {
+    Path path;
+    StringView text;
+    // offset of the start of every line, only built when a location is first requested
+    mutable Vector<uint32_t> line_starts{};
+    void build_line_starts() const;
+    StringView view(const Token& tok) const {
+        const char* begin = text.data() + tok.offset();
+        return StringView{begin, begin + tok.length()};
     }
-    constexpr const StringView& token() const noexcept { return m_token; }
-    constexpr TokenKind kind() const noexcept { return m_kind; }
-    constexpr const FsStringView& source_file() const noexcept { return m_source_file; }
-    constexpr size_t line() const noexcept { return m_line; }
-    constexpr size_t column() const noexcept { return m_column; }
-    constexpr void set_as_label() noexcept { m_kind = TokenKind::Label; }
+    SourceLocation location(uint32_t offset) const;
+    StringView line(size_t line) const;
 };
 
 using tit = ConstIterator<Token>;
@@ -76,29 +92,65 @@ class TokenizeError : public Error {
 
 using TokenizeResult = DiscardResult<TokenizeError>;
 
+// Tokens [first, old_end) of the previous token stream were replaced by [first, new_end) of the current one.
+struct TokenEdit {
+    size_t first = 0;
+    size_t old_end = 0;
+    size_t new_end = 0;
+    // false if either side of the edit has directives, or a statement could continue across the edit's edges
+    bool plain = false;
+};
+
 class Tokenizer {
     Vector<Token> m_tokens{};
-    Vector<String> m_lines{};
+    Vector<SourceFile> m_sources{};
+    SymbolTable m_symbols{};
+    // copies of the names whose only occurrence was cut out of the source by retokenize()
+    Vector<Vector<char>> m_detached_names{};
+    // index of the first token of every chunk, empty if the source was tokenized in one piece
+    Vector<uint32_t> m_chunk_starts{};
+    MappedFile m_mapping{};
+    MessageSink m_messages{};
+    String m_buffer{};
     File m_file;
     Path m_source_file;
     void print_error(const StringView& error, const Token& tok) const;
+    template <typename ScannerT>
+    bool tokenize_range(const char* range_begin, const char* range_end, Vector<Token>& tokens, SymbolTable& symbols,
+                        bool quiet) const;
+    template <typename ScannerT>
+    TokenizeResult tokenize_with();
+    template <typename ScannerT>
+    bool bench_with(const char* name);
     friend class Parser;
 
     public:
     Tokenizer(const Path& filename) : m_file(filename), m_source_file(m_file.name().narrow()) {}
     DiscardResult<FileError> open();
     TokenizeResult tokenize();
+    // splits large sources at line boundaries and tokenizes the pieces concurrently, the result is the same as
+    // tokenize()'s
+    TokenizeResult tokenize(const ThreadPool& pool);
+    // replaces the source (opened or not) with text, tokenize() has to be called again
+    void load(String text);
+    // Replaces the source with text, which only differs from the current source in the bytes [begin, old_end)
+    // that became [begin, new_end), and only tokenizes those bytes again. Both ranges have to be whole lines. If
+    // they don't tokenize cleanly the whole source is tokenized again, so the errors get reported, and the edit
+    // covers every token.
+    TokenizeResult retokenize(String text, size_t begin, size_t old_end, size_t new_end, TokenEdit& edit);
+    // tokenizes the source repeatedly with the scalar and the vectorized scanners and prints their throughput
+    TokenizeResult bench_lexer();
     const Vector<Token>& tokens() const { return m_tokens; }
+    const Vector<uint32_t>& chunk_starts() const { return m_chunk_starts; }
+    const SymbolTable& symbols() const { return m_symbols; }
+    StringView source_text() const { return m_sources[0].text; }
+    const SourceFile& source(const Token& tok) const { return m_sources[tok.file_id()]; }
+    StringView text(const Token& tok) const { return source(tok).view(tok); }
+    SourceLocation location(const Token& tok) const { return source(tok).location(tok.offset()); }
+    String describe(const Token& tok) const;
     void dump_tokens() const;
     const auto& source_file() const { return m_source_file; }
-};
-
-template <>
-struct ARLib::PrintInfo<Token> {
-    const Token& m_token;
-    constexpr PrintInfo(const Token& token) noexcept : m_token(token) {}
-    String repr() const {
-        return Printer::format("Token {{ {} \"{}\", in {} at {}:{} }}", enum_to_str_view(m_token.kind()),
-                               m_token.token(), m_token.source_file(), m_token.line() + 1, m_token.column());
-    }
+    // diagnostics and dumps of the tokenizer and of the parsers using it go through here
+    MessageSink& messages() { return m_messages; }
+    const MessageSink& messages() const { return m_messages; }
 };
\ No newline at end of file
@@ -1,4 +1,8 @@
+#include "AssemblerServer.h"
+#include "Incremental.h"
 #include "Parser.h"
+#include "Stats.h"
+#include "ThreadPool.h"
 #include "Tokenizer.h"
 #include <ArgParser.hpp>
 #define EXIT_FAILURE 1
@@ -12,6 +16,15 @@ int main(int argc, char** argv) {
     bool dump_tokens = false;
     bool dump_instructions = false;
     bool not_encode_instructions = false;
+    bool print_stats = false;
+    bool bench_lexer = false;
+    bool binary_code = false;
+    bool watch = false;
+    bool send_path = false;
+    bool stop = false;
+    String jobs{};
+    String serve_socket{};
+    String connect_socket{};
     ArgParser argparse{argc, argv};
     argparse.add_version(1, 0);
     argparse.allow_unmatched(1);
@@ -21,38 +34,107 @@ int main(int argc, char** argv) {
     argparse.add_option("--tokens", "Dump tokens", dump_tokens);
     argparse.add_option("--instructions", "Dump instructions", dump_instructions);
     argparse.add_option("--no-encode", "Do not encode instructions", not_encode_instructions);
+    argparse.add_option("--binary", "Write the encoded instructions as raw words to <file>.cbin", binary_code);
+    argparse.add_option("--stats",
+                        "Print timing and memory statistics for every phase. Memory is sampled at the end of each "
+                        "phase, on Linux the heap's maximum is the largest sample and misses what a phase frees",
+                        print_stats);
+    argparse.add_option("--jobs", "count", "Number of threads to assemble with (default: one per core)", jobs);
+    argparse.add_option("--watch", "Assemble the file again every time it's saved, redoing only what changed", watch);
+    argparse.add_option("--serve", "socket",
+                        "Run as a server assembling the requests sent to the socket, .incbin paths are relative to "
+                        "the server's working directory",
+                        serve_socket);
+    argparse.add_option("--connect", "socket", "Have the server listening on the socket assemble the file",
+                        connect_socket);
+    argparse.add_option("--send-path", "With --connect, let the server read the file instead of sending it",
+                        send_path);
+    argparse.add_option("--stop-server", "With --connect, ask the server to stop", stop);
+    argparse.add_option("--bench-lexer", "Measure the tokenizer throughput on the input file", bench_lexer);
     if (argparse.parse()) {
         if (argparse.help_requested()) {
             argparse.print_help();
             return EXIT_SUCCESS;
         }
         const auto& unmatched = argparse.unmatched();
-        if (unmatched.size() != 1) {
+        const bool needs_file = serve_socket.is_empty() && !(stop && !connect_socket.is_empty());
+        if (unmatched.size() != (needs_file ? 1 : 0)) {
             argparse.print_help();
             return EXIT_FAILURE;
         }
+        size_t thread_count = 0;
+        if (!jobs.is_empty()) {
+            auto count_or_err = StrViewToUInt(jobs.view());
+            if (count_or_err.is_error()) {
+                Printer::print("Invalid thread count {}", jobs);
+                return EXIT_FAILURE;
+            }
+            thread_count = count_or_err.to_ok();
+        }
+        ThreadPool pool{thread_count};
+        if (!serve_socket.is_empty()) {
+            AssemblerServer server{pool};
+            if (auto res = server.listen(serve_socket.view()); res.is_error()) {
+                Printer::print("Error listening on {}: {}", serve_socket, res.to_error());
+                return EXIT_FAILURE;
+            }
+            server.serve();
+            return EXIT_SUCCESS;
+        }
+        if (!connect_socket.is_empty()) {
+            if (stop) return stop_server(connect_socket.view()) ? EXIT_SUCCESS : EXIT_FAILURE;
+            const ClientOptions options{dump_rodata,      dump_tokens, dump_labels, dump_instructions,
+                                        not_encode_instructions, binary_code, send_path};
+            return assemble_remotely(connect_socket.view(), unmatched[0], pool, options) ? EXIT_SUCCESS
+                                                                                         : EXIT_FAILURE;
+        }
+        if (watch) {
+            IncrementalAssembler assembler{unmatched[0], pool, binary_code, dump_rodata};
+            return assembler.watch() ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        Stats stats{};
         Tokenizer tok{unmatched[0]};
-        if (auto res = tok.open(); res.is_error()) {
+        if (auto res = stats.time("open"_sv, [&] { return tok.open(); }); res.is_error()) {
             Printer::print("Error opening file: {}", res.to_error());
             return EXIT_FAILURE;
         }
-        if (auto res = tok.tokenize(); res.is_error()) {
+        if (bench_lexer) {
+            if (auto res = tok.bench_lexer(); res.is_error()) {
+                Printer::print("Error tokenizing file: {}", res.to_error());
+                return EXIT_FAILURE;
+            }
+            return EXIT_SUCCESS;
+        }
+        if (auto res = stats.time("tokenize"_sv, [&] { return tok.tokenize(pool); }); res.is_error()) {
             Printer::print("Error tokenizing file: {}", res.to_error());
             return EXIT_FAILURE;
         }
         if (dump_tokens) { tok.dump_tokens(); }
         Parser parser{tok};
-        parser.parse();
+        stats.time("parse"_sv, [&] { return parser.parse(pool); });
         if (dump_labels) { parser.dump_labels(); }
         if (dump_rodata) {
-            if (!parser.dump_binary_data()) {
+            if (!stats.time("dump_binary_data"_sv, [&] { return parser.dump_binary_data(); })) {
                 Printer::print("Error dumping binary data because {}", last_error());
                 return EXIT_FAILURE;
             }
         }
         if (dump_instructions) { parser.dump_instructions(); }
-        if (!not_encode_instructions) { parser.encode_instructions(); }
+        if (!not_encode_instructions) {
+            if (!stats.time("encode_instructions"_sv, [&] { return parser.encode_instructions(pool, binary_code); })) {
+                Printer::print("Error writing encoded instructions because {}", last_error());
+                return EXIT_FAILURE;
+            }
+        }
         Printer::print("File {} finished assembling successfully", unmatched[0]);
+        if (print_stats) {
+            stats.set_counter("tokens"_sv, tok.tokens().size());
+            stats.set_counter("instructions"_sv, parser.instructions().size());
+            stats.set_counter("labels"_sv, parser.label_count());
+            stats.set_counter("data bytes"_sv, parser.data_size());
+            stats.set_counter("code bytes"_sv, parser.instructions().size() * sizeof(uint32_t));
+            stats.report();
+        }
     }
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "CPU.h"
+#include "Parser.h"
+#include "Stats.h"
+#include "ThreadPool.h"
+#include "Tokenizer.h"
+#include <ArgParser.hpp>
+#define EXIT_FAILURE 1
+#define EXIT_SUCCESS 0
+
+using namespace ARLib;
+
+// The data section as the emulator sees it through the .dat file, which only holds whole 64-bit words of every span
+static void collect_data(const Parser& parser, Vector<uint8_t>& data) {
+    data.reserve(static_cast<size_t>(parser.data_size()));
+    parser.for_each_data_span([&data](const uint8_t* bytes, size_t size) {
+        append_bytes(data, bytes, size - size % sizeof(uint64_t));
+    });
+}
+
+int main(int argc, char** argv) {
+    bool print_stats = false;
+    String jobs{};
+    String max_steps{};
+    String max_cycles{};
+    String time_limit{};
+    ArgParser argparse{argc, argv};
+    argparse.add_version(1, 0);
+    argparse.allow_unmatched(1);
+    argparse.add_usage_string("./ASQRun.exe [options] <file>.s");
+    argparse.add_option("--jobs", "count", "Number of threads to assemble with (default: one per core)", jobs);
+    argparse.add_option("--max-steps", "count", "Stop the program after this many instructions (default: 100000000)",
+                        max_steps);
+    argparse.add_option("--max-cycles", "count", "Stop the program after this many cycles (default: no limit)",
+                        max_cycles);
+    argparse.add_option("--time-limit", "ms", "Stop the program after this many milliseconds (default: no limit)",
+                        time_limit);
+    argparse.add_option("--stats", "Print timing and memory statistics for every phase", print_stats);
+    if (auto ec = argparse.parse(); ec.is_error()) {
+        Printer::print("Error parsing arguments: {}", ec.to_error().error_string());
+        return EXIT_FAILURE;
+    }
+    if (argparse.help_requested()) {
+        argparse.print_help();
+        return EXIT_SUCCESS;
+    }
+    const auto& unmatched = argparse.unmatched();
+    if (unmatched.size() != 1) {
+        argparse.print_help();
+        return EXIT_FAILURE;
+    }
+    size_t thread_count = 0;
+    if (!jobs.is_empty()) {
+        auto count_or_err = StrViewToUInt(jobs.view());
+        if (count_or_err.is_error()) {
+            Printer::print("Invalid thread count {}", jobs);
+            return EXIT_FAILURE;
+        }
+        thread_count = count_or_err.to_ok();
+    }
+    RunLimits limits{};
+    limits.max_steps = 100'000'000;
+    if (!parse_count(max_steps, "instruction count"_sv, limits.max_steps) ||
+        !parse_count(max_cycles, "cycle count"_sv, limits.max_cycles) ||
+        !parse_count(time_limit, "time limit"_sv, limits.time_limit_ms))
+        return EXIT_FAILURE;
+
+    // the assembler's words and data go straight to the CPU, nothing is written or formatted as text in between
+    ThreadPool pool{thread_count};
+    Stats stats{};
+    Tokenizer tok{unmatched[0]};
+    if (auto res = stats.time("open"_sv, [&] { return tok.open(); }); res.is_error()) {
+        Printer::print("Error opening file: {}", res.to_error());
+        return EXIT_FAILURE;
+    }
+    if (auto res = stats.time("tokenize"_sv, [&] { return tok.tokenize(pool); }); res.is_error()) {
+        Printer::print("Error tokenizing file: {}", res.to_error());
+        return EXIT_FAILURE;
+    }
+    Parser parser{tok};
+    stats.time("parse"_sv, [&] { return parser.parse(pool); });
+    if (parser.has_errors() || parser.has_unresolved_labels()) {
+        Printer::print("File {} has errors, not running it", unmatched[0]);
+        return EXIT_FAILURE;
+    }
+    InstructionData program{};
+    BinaryData data{};
+    stats.time("load"_sv, [&] {
+        const auto words = parser.encode(pool);
+        program.load_words(words.data(), words.size());
+        Vector<uint8_t> image{};
+        collect_data(parser, image);
+        data.load_image(image.data(), image.size());
+    });
+    CPU cpu{};
+    cpu.load(program, data);
+    const StopReason reason = stats.time("run"_sv, [&] { return cpu.run_for(limits); });
+    CPU::print_result(reason, cpu.state(), cpu.memory_digest());
+    if (print_stats) {
+        stats.set_counter("instructions"_sv, program.instructions.size());
+        stats.set_counter("steps"_sv, cpu.clock_count());
+        stats.set_counter("cycles"_sv, cpu.cycles());
+        stats.set_counter("exit status"_sv, static_cast<uint64_t>(exit_status(reason)));
+        stats.report();
+    }
+    return exit_status(reason);
+}
\ No newline at end of file
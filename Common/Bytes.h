@@ -0,0 +1,24 @@
+#pragma once
+#include <Types.hpp>
+#include <Vector.hpp>
+
+using namespace ARLib;
+
+// FNV-1a, good enough to tell contents apart before comparing them in full
+inline uint64_t content_hash(const uint8_t* bytes, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+inline uint64_t content_hash(const Vector<uint8_t>& bytes) {
+    return content_hash(bytes.data(), bytes.size());
+}
+
+inline void append_bytes(Vector<uint8_t>& out, const void* data, size_t size) {
+    const size_t offset = out.size();
+    out.resize(offset + size);
+    if (size > 0) ARLib::memcpy(out.data() + offset, data, size);
+}
\ No newline at end of file
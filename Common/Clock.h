@@ -0,0 +1,7 @@
+#pragma once
+#include <Types.hpp>
+
+using namespace ARLib;
+
+// nanoseconds from an arbitrary point, never goes backwards
+uint64_t monotonic_ns();
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "Isa.h"
+#include <cstdio_compat.hpp>
+
+// Branch and jump operands are written as the absolute address they go to, the way encode_instruction() reads them
+static long long operand_value(uint32_t word, uint64_t pc, OperandField field) {
+    switch (field) {
+    case OperandField::None:
+        return 0;
+    case OperandField::Reg21:
+        return static_cast<int32_t>((word >> 21) & 0x1F);
+    case OperandField::Reg16:
+        return static_cast<int32_t>((word >> 16) & 0x1F);
+    case OperandField::Reg11:
+        return static_cast<int32_t>((word >> 11) & 0x1F);
+    case OperandField::Reg6:
+    case OperandField::Shift:
+        return static_cast<int32_t>((word >> 6) & 0x1F);
+    case OperandField::Imm16:
+        return static_cast<int16_t>(word & 0xFFFF);
+    case OperandField::Rel16:
+        return static_cast<long long>(pc + 4 + static_cast<uint64_t>(static_cast<int16_t>(word & 0xFFFF)) * 4);
+    case OperandField::Rel26:
+        return static_cast<long long>(pc + 4 + static_cast<uint64_t>(static_cast<int32_t>(word << 6) >> 6) * 4);
+    }
+    return 0;
+}
+
+int disassemble(uint32_t word, uint64_t pc, char* buffer, size_t size) {
+    const uint8_t row = decode_instruction(word);
+    if (row == invalid_instruction) return ARLib::snprintf(buffer, size, "unknown instruction %08X", word);
+    const IsaEntry& entry = isa_table[row];
+    Array<long long, 4> values{};
+    size_t count = 0;
+    for (size_t i = 0; i < entry.arg_count; ++i) {
+        values[count++] = operand_value(word, pc, entry.operands[i].field);
+        if (entry.operands[i].type == ArgumentType::ImmWReg)
+            values[count++] = operand_value(word, pc, OperandField::Reg21);
+    }
+    return ARLib::snprintf(buffer, size, disassembly_formats[row].data(), values[0], values[1], values[2], values[3]);
+}
\ No newline at end of file
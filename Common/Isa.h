@@ -0,0 +1,368 @@
+#pragma once
+#include <Array.hpp>
+#include <EnumHelpers.hpp>
+#include <StringView.hpp>
+#include <Types.hpp>
+
+using namespace ARLib;
+
+// The instruction set, described once for the assembler and the emulator. Every instruction is a row of isa_table:
+// its mnemonic, its format and fixed code, and where each of its arguments goes in the encoded word. The encoder,
+// the decode tables and the disassembly formats are all generated from it at compile time, so adding an instruction
+// means adding its enum value and its row.
+
+MAKE_FANCY_ENUM(RegisterEnum, uint8_t, r0, r1, r2, r3, r4, r5, r6, r7, r8, r9, r10, r11, r12, r13, r14, r15, r16, r17,
+                r18, r19, r20, r21, r22, r23, r24, r25, r26, r27, r28, r29, r30, r31, f0, f1, f2, f3, f4, f5, f6, f7,
+                f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27, f28,
+                f29, f30, f31)
+
+MAKE_FANCY_ENUM(Instruction, uint8_t, LoadByte, LoadByteUnsigned, StoreByte, LoadHalfWord, LoadHalfWordUnsigned,
+                StoreHalfWord, LoadWord, LoadWordUnsigned, StoreWord, LoadDoubleWord, StoreDoubleWord, LoadReal,
+                StoreReal, Halt, AddImmediate, AddImmediateUnsigned, LogicalAndImmediate, LogicalOrImmediate,
+                LogicalXorImmediate, LoadUpperImmediate, SetLessThanImmediate, SetLessThanImmediateUnsigned,
+                BranchIfEqual, BranchIfNotEqual, BranchIfZero, BranchIfNotZero, Jump, JumpToReg, JumpAndLink,
+                JumpAndLinkToReg, ShiftLefLogical, ShiftRightLogical, ShiftRightArithmetic, ShiftLeftByVar,
+                ShiftRightByVar, ShiftRightArithByVar, MoveIfZero, MoveIfNotZero, Nop, LogicalAnd, LogicalOr,
+                LogicalXor, SetLessThan, SetLessThanUnsigned, Add, AddUnsigned, Subtract, SubtractUnsigned, Multiply,
+                MultiplyUnsigned, Divide, DivideUnsigned, AddReal, SubtractReal, MultiplyReal, DivideReal, MoveReal,
+                ConvertIntegerToReal, ConvertRealToInteger, SetFpFlagIfLessThan, SetFpFlagIfLessThanOrEqual,
+                SetFpFlagIfEqual, BranchIfFpFlagNotSet, BranchIfFpFlagSet, MoveDataFromIntegerToFp,
+                MoveDataFromFpToInteger)
+
+MAKE_FANCY_ENUM(ArgumentType, uint8_t, Reg, Freg, Imm, ImmWReg);
+
+// Instruction formats. The fixed bits of an encoding are the code shifted into the field the format keeps it in:
+// I, J: the opcode (bits 26-31). R: the function (bits 0-5) under SPECIAL. F: the function under COP1 with the
+// double format. M: the rs field (bits 21-25) under COP1. B: the true/false bit (bit 16) of a COP1 BC.
+enum class OpcodeType : uint8_t { R = 1, I = 2, J = 3, F = 4, M = 5, B = 6 };
+
+constexpr uint32_t op_special = 0x00;
+constexpr uint32_t op_cop1 = 0x11;
+constexpr uint32_t cop1_double = 0x11;
+constexpr uint32_t cop1_bc = 0x08;
+
+// Where an argument goes in the encoded word. Registers are 5-bit fields starting at the given bit, Shift is the
+// shift amount at bit 6, Rel16 and Rel26 are offsets in instructions from the next one. The offset of an ImmWReg
+// argument is Imm16 and its base register always goes to bits 21-25.
+enum class OperandField : uint8_t { None, Reg21, Reg16, Reg11, Reg6, Shift, Imm16, Rel16, Rel26 };
+
+struct Operand {
+    ArgumentType type = ArgumentType::Reg;
+    OperandField field = OperandField::None;
+};
+
+namespace Operands {
+    constexpr Operand rs{ArgumentType::Reg, OperandField::Reg21};
+    constexpr Operand rt{ArgumentType::Reg, OperandField::Reg16};
+    constexpr Operand rd{ArgumentType::Reg, OperandField::Reg11};
+    constexpr Operand fs{ArgumentType::Freg, OperandField::Reg11};
+    constexpr Operand ft{ArgumentType::Freg, OperandField::Reg16};
+    constexpr Operand fd{ArgumentType::Freg, OperandField::Reg6};
+    constexpr Operand imm{ArgumentType::Imm, OperandField::Imm16};
+    constexpr Operand shift{ArgumentType::Imm, OperandField::Shift};
+    constexpr Operand offset{ArgumentType::ImmWReg, OperandField::Imm16};
+    constexpr Operand rel16{ArgumentType::Imm, OperandField::Rel16};
+    constexpr Operand rel26{ArgumentType::Imm, OperandField::Rel26};
+} // namespace Operands
+
+struct IsaEntry {
+    Instruction insn;
+    StringView name;
+    OpcodeType type;
+    uint8_t code;
+    Array<Operand, 3> operands;
+    size_t arg_count;
+    constexpr uint32_t fixed_bits() const {
+        switch (type) {
+        case OpcodeType::I:
+        case OpcodeType::J:
+            return static_cast<uint32_t>(code) << 26;
+        case OpcodeType::R:
+            return op_special << 26 | code;
+        case OpcodeType::F:
+            return op_cop1 << 26 | cop1_double << 21 | code;
+        case OpcodeType::M:
+            return op_cop1 << 26 | static_cast<uint32_t>(code) << 21;
+        case OpcodeType::B:
+            return op_cop1 << 26 | cop1_bc << 21 | static_cast<uint32_t>(code) << 16;
+        }
+        return 0;
+    }
+};
+
+constexpr IsaEntry isa_entry(Instruction insn, StringView name, OpcodeType type, uint8_t code, Operand a = {},
+                             Operand b = {}, Operand c = {}) {
+    IsaEntry entry{insn, name, type, code, Array<Operand, 3>{a, b, c}, 0};
+    while (entry.arg_count < entry.operands.size() && entry.operands[entry.arg_count].field != OperandField::None)
+        ++entry.arg_count;
+    return entry;
+}
+
+// rows in the order of the Instruction enum
+constexpr auto construct_isa_table() {
+    using namespace Operands;
+    return Array{isa_entry(Instruction::LoadByte, "lb"_sv, OpcodeType::I, 0x20, rt, offset),
+                 isa_entry(Instruction::LoadByteUnsigned, "lbu"_sv, OpcodeType::I, 0x24, rt, offset),
+                 isa_entry(Instruction::StoreByte, "sb"_sv, OpcodeType::I, 0x28, rt, offset),
+                 isa_entry(Instruction::LoadHalfWord, "lh"_sv, OpcodeType::I, 0x21, rt, offset),
+                 isa_entry(Instruction::LoadHalfWordUnsigned, "lhu"_sv, OpcodeType::I, 0x25, rt, offset),
+                 isa_entry(Instruction::StoreHalfWord, "sh"_sv, OpcodeType::I, 0x29, rt, offset),
+                 isa_entry(Instruction::LoadWord, "lw"_sv, OpcodeType::I, 0x23, rt, offset),
+                 isa_entry(Instruction::LoadWordUnsigned, "lwu"_sv, OpcodeType::I, 0x27, rt, offset),
+                 isa_entry(Instruction::StoreWord, "sw"_sv, OpcodeType::I, 0x2B, rt, offset),
+                 isa_entry(Instruction::LoadDoubleWord, "ld"_sv, OpcodeType::I, 0x37, rt, offset),
+                 isa_entry(Instruction::StoreDoubleWord, "sd"_sv, OpcodeType::I, 0x3F, rt, offset),
+                 isa_entry(Instruction::LoadReal, "l.d"_sv, OpcodeType::I, 0x35, ft, offset),
+                 isa_entry(Instruction::StoreReal, "s.d"_sv, OpcodeType::I, 0x3D, ft, offset),
+                 isa_entry(Instruction::Halt, "halt"_sv, OpcodeType::I, 0x01),
+                 isa_entry(Instruction::AddImmediate, "daddi"_sv, OpcodeType::I, 0x18, rt, rs, imm),
+                 isa_entry(Instruction::AddImmediateUnsigned, "daddui"_sv, OpcodeType::I, 0x19, rt, rs, imm),
+                 isa_entry(Instruction::LogicalAndImmediate, "andi"_sv, OpcodeType::I, 0x0C, rt, rs, imm),
+                 isa_entry(Instruction::LogicalOrImmediate, "ori"_sv, OpcodeType::I, 0x0D, rt, rs, imm),
+                 isa_entry(Instruction::LogicalXorImmediate, "xori"_sv, OpcodeType::I, 0x0E, rt, rs, imm),
+                 isa_entry(Instruction::LoadUpperImmediate, "lui"_sv, OpcodeType::I, 0x0F, rt, imm),
+                 isa_entry(Instruction::SetLessThanImmediate, "slti"_sv, OpcodeType::I, 0x0A, rt, rs, imm),
+                 isa_entry(Instruction::SetLessThanImmediateUnsigned, "sltiu"_sv, OpcodeType::I, 0x0B, rt, rs, imm),
+                 isa_entry(Instruction::BranchIfEqual, "beq"_sv, OpcodeType::I, 0x04, rt, rs, rel16),
+                 isa_entry(Instruction::BranchIfNotEqual, "bne"_sv, OpcodeType::I, 0x05, rt, rs, rel16),
+                 isa_entry(Instruction::BranchIfZero, "beqz"_sv, OpcodeType::I, 0x06, rt, rel16),
+                 isa_entry(Instruction::BranchIfNotZero, "bnez"_sv, OpcodeType::I, 0x07, rt, rel16),
+                 isa_entry(Instruction::Jump, "j"_sv, OpcodeType::J, 0x02, rel26),
+                 isa_entry(Instruction::JumpToReg, "jr"_sv, OpcodeType::R, 0x08, rt),
+                 isa_entry(Instruction::JumpAndLink, "jal"_sv, OpcodeType::J, 0x03, rel26),
+                 isa_entry(Instruction::JumpAndLinkToReg, "jalr"_sv, OpcodeType::R, 0x09, rt),
+                 isa_entry(Instruction::ShiftLefLogical, "dsll"_sv, OpcodeType::R, 0x38, rd, rs, shift),
+                 isa_entry(Instruction::ShiftRightLogical, "dsrl"_sv, OpcodeType::R, 0x3A, rd, rs, shift),
+                 isa_entry(Instruction::ShiftRightArithmetic, "dsra"_sv, OpcodeType::R, 0x3B, rd, rs, shift),
+                 isa_entry(Instruction::ShiftLeftByVar, "dsllv"_sv, OpcodeType::R, 0x14, rd, rs, rt),
+                 isa_entry(Instruction::ShiftRightByVar, "dsrlv"_sv, OpcodeType::R, 0x16, rd, rs, rt),
+                 isa_entry(Instruction::ShiftRightArithByVar, "dsrav"_sv, OpcodeType::R, 0x17, rd, rs, rt),
+                 isa_entry(Instruction::MoveIfZero, "movz"_sv, OpcodeType::R, 0x0A, rd, rs, rt),
+                 isa_entry(Instruction::MoveIfNotZero, "movn"_sv, OpcodeType::R, 0x0B, rd, rs, rt),
+                 isa_entry(Instruction::Nop, "nop"_sv, OpcodeType::R, 0x00),
+                 isa_entry(Instruction::LogicalAnd, "and"_sv, OpcodeType::R, 0x24, rd, rs, rt),
+                 isa_entry(Instruction::LogicalOr, "or"_sv, OpcodeType::R, 0x25, rd, rs, rt),
+                 isa_entry(Instruction::LogicalXor, "xor"_sv, OpcodeType::R, 0x26, rd, rs, rt),
+                 isa_entry(Instruction::SetLessThan, "slt"_sv, OpcodeType::R, 0x2A, rd, rs, rt),
+                 isa_entry(Instruction::SetLessThanUnsigned, "sltu"_sv, OpcodeType::R, 0x2B, rd, rs, rt),
+                 isa_entry(Instruction::Add, "dadd"_sv, OpcodeType::R, 0x2C, rd, rs, rt),
+                 isa_entry(Instruction::AddUnsigned, "daddu"_sv, OpcodeType::R, 0x2D, rd, rs, rt),
+                 isa_entry(Instruction::Subtract, "dsub"_sv, OpcodeType::R, 0x2E, rd, rs, rt),
+                 isa_entry(Instruction::SubtractUnsigned, "dsubu"_sv, OpcodeType::R, 0x2F, rd, rs, rt),
+                 isa_entry(Instruction::Multiply, "dmul"_sv, OpcodeType::R, 0x1C, rd, rs, rt),
+                 isa_entry(Instruction::MultiplyUnsigned, "dmulu"_sv, OpcodeType::R, 0x1D, rd, rs, rt),
+                 isa_entry(Instruction::Divide, "ddiv"_sv, OpcodeType::R, 0x1E, rd, rs, rt),
+                 isa_entry(Instruction::DivideUnsigned, "ddivu"_sv, OpcodeType::R, 0x1F, rd, rs, rt),
+                 isa_entry(Instruction::AddReal, "add.d"_sv, OpcodeType::F, 0x00, fd, fs, ft),
+                 isa_entry(Instruction::SubtractReal, "sub.d"_sv, OpcodeType::F, 0x01, fd, fs, ft),
+                 isa_entry(Instruction::MultiplyReal, "mul.d"_sv, OpcodeType::F, 0x02, fd, fs, ft),
+                 isa_entry(Instruction::DivideReal, "div.d"_sv, OpcodeType::F, 0x03, fd, fs, ft),
+                 isa_entry(Instruction::MoveReal, "mov.d"_sv, OpcodeType::F, 0x06, fd, fs),
+                 isa_entry(Instruction::ConvertIntegerToReal, "cvt.d.l"_sv, OpcodeType::F, 0x21, fd, fs),
+                 isa_entry(Instruction::ConvertRealToInteger, "cvt.l.d"_sv, OpcodeType::F, 0x25, fd, fs),
+                 isa_entry(Instruction::SetFpFlagIfLessThan, "c.lt.d"_sv, OpcodeType::F, 0x3C, fs, ft),
+                 isa_entry(Instruction::SetFpFlagIfLessThanOrEqual, "c.le.d"_sv, OpcodeType::F, 0x3E, fs, ft),
+                 isa_entry(Instruction::SetFpFlagIfEqual, "c.eq.d"_sv, OpcodeType::F, 0x32, fs, ft),
+                 isa_entry(Instruction::BranchIfFpFlagNotSet, "bc1f"_sv, OpcodeType::B, 0x00, rel16),
+                 isa_entry(Instruction::BranchIfFpFlagSet, "bc1t"_sv, OpcodeType::B, 0x01, rel16),
+                 isa_entry(Instruction::MoveDataFromIntegerToFp, "mtc1"_sv, OpcodeType::M, 0x04, rt, fs),
+                 isa_entry(Instruction::MoveDataFromFpToInteger, "mfc1"_sv, OpcodeType::M, 0x00, rt, fs)};
+}
+
+constexpr auto isa_table = construct_isa_table();
+
+constexpr bool isa_table_matches_enum() {
+    if (isa_table.size() != enum_size<Instruction>()) return false;
+    for (size_t i = 0; i < isa_table.size(); ++i) {
+        if (static_cast<size_t>(ToUnderlying(isa_table[i].insn)) != i) return false;
+    }
+    return true;
+}
+static_assert(isa_table_matches_enum(), "isa_table has to have one row per Instruction, in the same order");
+
+constexpr const IsaEntry& isa_info(Instruction insn) {
+    return isa_table[static_cast<size_t>(ToUnderlying(insn))];
+}
+
+// imm is the instruction's immediate or offset, for branches and jumps the absolute target that gets turned into an
+// offset from pc_address
+constexpr uint32_t encode_instruction(Instruction insn, const Array<RegisterEnum, 3>& regs, int32_t imm,
+                                      uint32_t pc_address) {
+    const IsaEntry& info = isa_info(insn);
+    uint32_t encoded = info.fixed_bits();
+    for (size_t i = 0; i < info.arg_count; ++i) {
+        const Operand& operand = info.operands[i];
+        uint32_t reg = ToUnderlying(regs[i]);
+        if (operand.type == ArgumentType::Freg) reg -= ToUnderlying(RegisterEnum::f0);
+        if (operand.type == ArgumentType::ImmWReg) encoded |= reg << 21;
+        switch (operand.field) {
+        case OperandField::None:
+            break;
+        case OperandField::Reg21:
+            encoded |= reg << 21;
+            break;
+        case OperandField::Reg16:
+            encoded |= reg << 16;
+            break;
+        case OperandField::Reg11:
+            encoded |= reg << 11;
+            break;
+        case OperandField::Reg6:
+            encoded |= reg << 6;
+            break;
+        case OperandField::Shift:
+            encoded |= static_cast<uint32_t>(imm) << 6;
+            break;
+        case OperandField::Imm16:
+            encoded |= static_cast<uint32_t>(imm) & 0xffff;
+            break;
+        case OperandField::Rel16:
+        case OperandField::Rel26: {
+            const int32_t rel = static_cast<int32_t>(static_cast<uint32_t>(imm) - (pc_address + 4)) / 4;
+            encoded |= static_cast<uint32_t>(rel) & (operand.field == OperandField::Rel16 ? 0xffff : 0x3ffffff);
+        } break;
+        }
+    }
+    return encoded;
+}
+
+// Decoding is one lookup by opcode, or two for SPECIAL and COP1 words: by function for SPECIAL and double
+// format COP1 instructions, by the rs field for the COP1 moves and by the true/false bit for the COP1 branches.
+// Entries are rows of isa_table.
+constexpr uint8_t invalid_instruction = 0xFF;
+struct DecodeTables {
+    Array<uint8_t, 64> by_opcode;
+    Array<uint8_t, 64> special;
+    Array<uint8_t, 64> cop1_double;
+    Array<uint8_t, 32> cop1_moves;
+    Array<uint8_t, 2> cop1_branches;
+    // no two rows claim the same encoding
+    bool unambiguous;
+};
+
+constexpr auto construct_decode_tables() {
+    DecodeTables tables{};
+    tables.unambiguous = true;
+    auto fill = [](auto& table) {
+        for (auto& entry : table)
+            entry = invalid_instruction;
+    };
+    fill(tables.by_opcode);
+    fill(tables.special);
+    fill(tables.cop1_double);
+    fill(tables.cop1_moves);
+    fill(tables.cop1_branches);
+    for (size_t i = 0; i < isa_table.size(); ++i) {
+        const IsaEntry& entry = isa_table[i];
+        uint8_t* slot = nullptr;
+        switch (entry.type) {
+        case OpcodeType::I:
+        case OpcodeType::J:
+            if (entry.code == op_special || entry.code == op_cop1) tables.unambiguous = false;
+            slot = &tables.by_opcode[entry.code];
+            break;
+        case OpcodeType::R:
+            slot = &tables.special[entry.code];
+            break;
+        case OpcodeType::F:
+            slot = &tables.cop1_double[entry.code];
+            break;
+        case OpcodeType::M:
+            if (entry.code == cop1_double || entry.code == cop1_bc) tables.unambiguous = false;
+            slot = &tables.cop1_moves[entry.code];
+            break;
+        case OpcodeType::B:
+            slot = &tables.cop1_branches[entry.code];
+            break;
+        }
+        if (*slot != invalid_instruction) tables.unambiguous = false;
+        *slot = static_cast<uint8_t>(i);
+    }
+    return tables;
+}
+
+constexpr auto decode_tables = construct_decode_tables();
+static_assert(decode_tables.unambiguous, "two instructions of isa_table have the same encoding");
+
+// row of isa_table the word is an encoding of, invalid_instruction if there's none
+constexpr uint8_t decode_instruction(uint32_t word) {
+    const uint32_t opcode = word >> 26;
+    if (opcode == op_special) return decode_tables.special[word & 0x3F];
+    if (opcode == op_cop1) {
+        const uint32_t rs = (word >> 21) & 0x1F;
+        if (rs == cop1_double) return decode_tables.cop1_double[word & 0x3F];
+        if (rs == cop1_bc) return decode_tables.cop1_branches[(word >> 16) & 1];
+        return decode_tables.cop1_moves[rs];
+    }
+    return decode_tables.by_opcode[opcode];
+}
+
+constexpr bool decoding_round_trips() {
+    for (size_t i = 0; i < isa_table.size(); ++i) {
+        if (decode_instruction(isa_table[i].fixed_bits()) != i) return false;
+    }
+    return true;
+}
+static_assert(decoding_round_trips(), "an encoding from isa_table doesn't decode back to its row");
+
+// The row can send the pc somewhere other than the next instruction or stop the program, so it's the last
+// instruction of a basic block. Words that aren't instructions do nothing and don't end one.
+constexpr bool ends_block(uint8_t id) {
+    if (id >= isa_table.size()) return false;
+    const IsaEntry& entry = isa_table[id];
+    switch (entry.insn) {
+    case Instruction::Halt:
+    case Instruction::JumpToReg:
+    case Instruction::JumpAndLinkToReg:
+        return true;
+    default:
+        break;
+    }
+    for (size_t i = 0; i < entry.arg_count; ++i) {
+        const OperandField field = entry.operands[i].field;
+        if (field == OperandField::Rel16 || field == OperandField::Rel26) return true;
+    }
+    return false;
+}
+
+// printf formats of the disassembly of each row, in the assembler's syntax. Their arguments are the values of the
+// operands in order as long long, an ImmWReg operand takes two: the offset and the base register.
+constexpr size_t max_disassembly_format = 32;
+constexpr auto construct_disassembly_formats() {
+    Array<Array<char, max_disassembly_format>, isa_table.size()> formats{};
+    for (size_t i = 0; i < isa_table.size(); ++i) {
+        const IsaEntry& entry = isa_table[i];
+        auto& format = formats[i];
+        size_t length = 0;
+        auto append = [&](StringView text) {
+            for (size_t c = 0; c < text.size(); ++c)
+                format[length++] = text[c];
+        };
+        append(entry.name);
+        for (size_t arg = 0; arg < entry.arg_count; ++arg) {
+            append(arg == 0 ? " "_sv : ", "_sv);
+            switch (entry.operands[arg].type) {
+            case ArgumentType::Reg:
+                append("r%lld"_sv);
+                break;
+            case ArgumentType::Freg:
+                append("f%lld"_sv);
+                break;
+            case ArgumentType::Imm:
+                append("%lld"_sv);
+                break;
+            case ArgumentType::ImmWReg:
+                append("%lld(r%lld)"_sv);
+                break;
+            }
+        }
+        format[length] = '\0';
+    }
+    return formats;
+}
+
+constexpr auto disassembly_formats = construct_disassembly_formats();
+
+// Writes the disassembly of the word at pc to buffer like snprintf, unknown encodings are written as such. Branch and
+// jump targets are absolute addresses, so the text assembles back to the same word at the same address.
+int disassemble(uint32_t word, uint64_t pc, char* buffer, size_t size);
\ No newline at end of file
@@ -0,0 +1,63 @@
+#include "LocalServer.h"
+#include <Printer.hpp>
+
+DiscardResult<FileError> LocalServer::listen(StringView socket_path) {
+    TRY(m_listener.listen(socket_path));
+    m_socket_path = String{socket_path};
+    return {};
+}
+
+bool LocalServer::stopping() {
+    LockGuard guard{m_lock};
+    return m_stopping;
+}
+
+// every worker blocked in accept() gets a connection of its own to notice the server is stopping
+void LocalServer::stop() {
+    {
+        LockGuard guard{m_lock};
+        m_stopping = true;
+    }
+    for (size_t i = 0; i < m_pool.size(); ++i) {
+        LocalSocket wake{};
+        if (wake.connect(m_socket_path.view()).is_error()) break;
+    }
+}
+
+void LocalServer::run(HandlerFn fn, void* ctx) {
+    Printer::print("Listening on {}", m_socket_path);
+    m_pool.parallel_for(m_pool.size(), [this, fn, ctx](size_t) {
+        LocalSocket client{};
+        Vector<uint8_t> request{};
+        Vector<uint8_t> reply{};
+        while (!stopping() && m_listener.accept(client)) {
+            if (stopping()) break;
+            while (client.receive_message(request)) {
+                fn(ctx, request, reply);
+                if (!client.send_message(reply.data(), reply.size())) break;
+            }
+            client.close();
+        }
+    });
+    m_listener.close();
+    LocalSocket::remove(m_socket_path.view());
+    Printer::print("Server stopped");
+}
+
+bool round_trip(StringView socket_path, const Vector<uint8_t>& request, Vector<uint8_t>& reply) {
+    LocalSocket server{};
+    if (auto res = server.connect(socket_path); res.is_error()) {
+        Printer::print("Error connecting to the server: {}", res.to_error());
+        return false;
+    }
+    if (!server.send_message(request.data(), request.size()) || !server.receive_message(reply)) {
+        Printer::print("Error talking to the server: connection lost");
+        return false;
+    }
+    return true;
+}
+
+void print_server_output(StringView output) {
+    if (output.size() > 0 && output[output.size() - 1] == '\n') output = StringView{output.data(), output.size() - 1};
+    if (output.size() > 0) Printer::print("{}", output);
+}
\ No newline at end of file
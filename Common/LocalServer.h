@@ -0,0 +1,55 @@
+#pragma once
+#include "LocalSocket.h"
+#include "ThreadPool.h"
+#include <Printer.hpp>
+#include <String.hpp>
+#include <StringView.hpp>
+#include <Vector.hpp>
+
+using namespace ARLib;
+
+// Long-running server behind a LocalSocket. Every thread of the pool serves one connection at a time and a
+// connection can send any number of requests, each one answered by the handler with a single reply message.
+class LocalServer {
+    using HandlerFn = void (*)(void*, const Vector<uint8_t>&, Vector<uint8_t>&);
+    template <typename Handler>
+    static void invoke(void* ctx, const Vector<uint8_t>& request, Vector<uint8_t>& reply) {
+        (*static_cast<Handler*>(ctx))(request, reply);
+    }
+    LocalSocket m_listener{};
+    String m_socket_path{};
+    const ThreadPool& m_pool;
+    Mutex m_lock{};
+    bool m_stopping = false;
+    bool stopping();
+    void run(HandlerFn fn, void* ctx);
+
+    public:
+    explicit LocalServer(const ThreadPool& pool) : m_pool(pool) {}
+    DiscardResult<FileError> listen(StringView socket_path);
+    // calls handler(request, reply) for every request from every client until one of the handlers calls stop()
+    template <typename Handler>
+    void serve(Handler& handler) {
+        run(&invoke<Handler>, &handler);
+    }
+    // the reply being handled is still sent, the connections after it aren't served
+    void stop();
+};
+
+// Sends a single request to the server and receives its reply, prints what went wrong and returns false if either
+// doesn't go through.
+bool round_trip(StringView socket_path, const Vector<uint8_t>& request, Vector<uint8_t>& reply);
+// round_trip() and checks the reply is a Reply header followed by its payload_size() bytes, which header gets
+template <typename Reply>
+bool round_trip(StringView socket_path, const Vector<uint8_t>& request, Vector<uint8_t>& reply, Reply& header) {
+    if (!round_trip(socket_path, request, reply)) return false;
+    if (reply.size() >= sizeof(header)) ARLib::memcpy(&header, reply.data(), sizeof(header));
+    if (reply.size() < sizeof(header) || header.magic != Reply::magic_value ||
+        reply.size() - sizeof(header) != header.payload_size()) {
+        Printer::print("Error talking to the server: malformed reply");
+        return false;
+    }
+    return true;
+}
+// prints the output a server captured, which already ends every message with a newline
+void print_server_output(StringView output);
\ No newline at end of file
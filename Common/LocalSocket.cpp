@@ -0,0 +1,255 @@
+#include "LocalSocket.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <afunix.h>
+#include <windows.h>
+#else
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+static bool make_address(StringView path, sockaddr_un& address) {
+    address = sockaddr_un{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return false;
+    ARLib::memcpy(address.sun_path, path.data(), path.size());
+    address.sun_path[path.size()] = '\0';
+    return true;
+}
+
+#ifdef _WIN32
+constexpr uintptr_t no_socket = static_cast<uintptr_t>(INVALID_SOCKET);
+
+static bool start_winsock() {
+    static const bool started = [] {
+        WSADATA data{};
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    return started;
+}
+
+static uintptr_t open_socket() {
+    if (!start_winsock()) return no_socket;
+    return static_cast<uintptr_t>(::socket(AF_UNIX, SOCK_STREAM, 0));
+}
+
+LocalSocket::LocalSocket(LocalSocket&& other) noexcept : m_socket(other.m_socket) {
+    other.m_socket = no_socket;
+}
+
+LocalSocket& LocalSocket::operator=(LocalSocket&& other) noexcept {
+    if (this == &other) return *this;
+    close();
+    m_socket = other.m_socket;
+    other.m_socket = no_socket;
+    return *this;
+}
+
+bool LocalSocket::is_open() const {
+    return m_socket != no_socket;
+}
+
+void LocalSocket::close() {
+    if (m_socket != no_socket) ::closesocket(static_cast<SOCKET>(m_socket));
+    m_socket = no_socket;
+}
+
+void LocalSocket::remove(StringView path) {
+    String name{path};
+    DeleteFileA(name.data());
+}
+
+DiscardResult<FileError> LocalSocket::connect(StringView path) {
+    close();
+    sockaddr_un address{};
+    if (!make_address(path, address)) { return FileError{"Socket path is too long"_s}; }
+    m_socket = open_socket();
+    if (m_socket == no_socket) { return FileError{"Failed to create socket"_s}; }
+    if (::connect(static_cast<SOCKET>(m_socket), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        close();
+        return FileError{"Failed to connect to socket"_s};
+    }
+    return {};
+}
+
+DiscardResult<FileError> LocalSocket::listen(StringView path) {
+    close();
+    sockaddr_un address{};
+    if (!make_address(path, address)) { return FileError{"Socket path is too long"_s}; }
+    if (LocalSocket probe{}; !probe.connect(path).is_error()) { return FileError{"A server is already listening"_s}; }
+    remove(path);
+    m_socket = open_socket();
+    if (m_socket == no_socket) { return FileError{"Failed to create socket"_s}; }
+    const SOCKET s = static_cast<SOCKET>(m_socket);
+    if (::bind(s, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(s, SOMAXCONN) != 0) {
+        close();
+        return FileError{"Failed to listen on socket"_s};
+    }
+    return {};
+}
+
+bool LocalSocket::accept(LocalSocket& client) const {
+    const SOCKET s = ::accept(static_cast<SOCKET>(m_socket), nullptr, nullptr);
+    if (s == INVALID_SOCKET) return false;
+    client.close();
+    client.m_socket = static_cast<uintptr_t>(s);
+    return true;
+}
+
+bool LocalSocket::send_all(const void* data, size_t size) {
+    const char* src = static_cast<const char*>(data);
+    while (size > 0) {
+        const int chunk = size > 0x40000000 ? 0x40000000 : static_cast<int>(size);
+        const int sent = ::send(static_cast<SOCKET>(m_socket), src, chunk, 0);
+        if (sent <= 0) return false;
+        src += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool LocalSocket::receive_all(void* data, size_t size) {
+    char* dst = static_cast<char*>(data);
+    while (size > 0) {
+        const int chunk = size > 0x40000000 ? 0x40000000 : static_cast<int>(size);
+        const int got = ::recv(static_cast<SOCKET>(m_socket), dst, chunk, 0);
+        if (got <= 0) return false;
+        dst += got;
+        size -= static_cast<size_t>(got);
+    }
+    return true;
+}
+#else
+#ifdef MSG_NOSIGNAL
+constexpr int send_flags = MSG_NOSIGNAL;
+#else
+constexpr int send_flags = 0;
+#endif
+
+// a peer that went away must not kill the process with SIGPIPE
+static int open_socket() {
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+#ifdef SO_NOSIGPIPE
+    if (fd >= 0) {
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+    }
+#endif
+    return fd;
+}
+
+LocalSocket::LocalSocket(LocalSocket&& other) noexcept : m_fd(other.m_fd) {
+    other.m_fd = -1;
+}
+
+LocalSocket& LocalSocket::operator=(LocalSocket&& other) noexcept {
+    if (this == &other) return *this;
+    close();
+    m_fd = other.m_fd;
+    other.m_fd = -1;
+    return *this;
+}
+
+bool LocalSocket::is_open() const {
+    return m_fd >= 0;
+}
+
+void LocalSocket::close() {
+    if (m_fd >= 0) ::close(m_fd);
+    m_fd = -1;
+}
+
+void LocalSocket::remove(StringView path) {
+    sockaddr_un address{};
+    if (make_address(path, address)) ::unlink(address.sun_path);
+}
+
+DiscardResult<FileError> LocalSocket::connect(StringView path) {
+    close();
+    sockaddr_un address{};
+    if (!make_address(path, address)) { return FileError{"Socket path is too long"_s}; }
+    m_fd = open_socket();
+    if (m_fd < 0) { return FileError{"Failed to create socket"_s}; }
+    if (::connect(m_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        close();
+        return FileError{"Failed to connect to socket"_s};
+    }
+    return {};
+}
+
+DiscardResult<FileError> LocalSocket::listen(StringView path) {
+    close();
+    sockaddr_un address{};
+    if (!make_address(path, address)) { return FileError{"Socket path is too long"_s}; }
+    if (LocalSocket probe{}; !probe.connect(path).is_error()) { return FileError{"A server is already listening"_s}; }
+    ::unlink(address.sun_path);
+    m_fd = open_socket();
+    if (m_fd < 0) { return FileError{"Failed to create socket"_s}; }
+    if (::bind(m_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(m_fd, SOMAXCONN) != 0) {
+        close();
+        return FileError{"Failed to listen on socket"_s};
+    }
+    return {};
+}
+
+bool LocalSocket::accept(LocalSocket& client) const {
+    int fd;
+    do {
+        fd = ::accept(m_fd, nullptr, nullptr);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0) return false;
+    client.close();
+    client.m_fd = fd;
+    return true;
+}
+
+bool LocalSocket::send_all(const void* data, size_t size) {
+    const char* src = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t sent = ::send(m_fd, src, size, send_flags);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return false;
+        src += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool LocalSocket::receive_all(void* data, size_t size) {
+    char* dst = static_cast<char*>(data);
+    while (size > 0) {
+        const ssize_t got = ::recv(m_fd, dst, size, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        dst += got;
+        size -= static_cast<size_t>(got);
+    }
+    return true;
+}
+#endif
+
+bool LocalSocket::send_message(const OutputSpan* spans, size_t count) {
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += spans[i].size;
+    }
+    if (total > max_message_size) return false;
+    const uint32_t length = static_cast<uint32_t>(total);
+    if (!send_all(&length, sizeof(length))) return false;
+    for (size_t i = 0; i < count; ++i) {
+        if (!send_all(spans[i].data, spans[i].size)) return false;
+    }
+    return true;
+}
+
+bool LocalSocket::receive_message(Vector<uint8_t>& message) {
+    uint32_t length = 0;
+    if (!receive_all(&length, sizeof(length)) || length > max_message_size) return false;
+    message.resize(length);
+    return receive_all(message.data(), length);
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+#include "OutputFile.h"
+#include <File.hpp>
+#include <StringView.hpp>
+#include <Types.hpp>
+#include <Vector.hpp>
+
+using namespace ARLib;
+
+// Stream socket bound to a filesystem path (AF_UNIX, which Windows 10 supports too). Everything sent through it is
+// a message: a 32-bit native-endian length followed by that many bytes, both ends always live on the same machine.
+class LocalSocket {
+#ifdef _WIN32
+    uintptr_t m_socket = ~static_cast<uintptr_t>(0);
+#else
+    int m_fd = -1;
+#endif
+    bool send_all(const void* data, size_t size);
+    bool receive_all(void* data, size_t size);
+
+    public:
+    constexpr static size_t max_message_size = 1024 * 1024 * 1024;
+    LocalSocket() = default;
+    LocalSocket(const LocalSocket&) = delete;
+    LocalSocket& operator=(const LocalSocket&) = delete;
+    LocalSocket(LocalSocket&& other) noexcept;
+    LocalSocket& operator=(LocalSocket&& other) noexcept;
+    ~LocalSocket() { close(); }
+    // Binds to path and starts listening. A stale socket file left by a server that died is replaced, one that
+    // still has a server behind it is an error.
+    DiscardResult<FileError> listen(StringView path);
+    DiscardResult<FileError> connect(StringView path);
+    // blocks until a client connects
+    bool accept(LocalSocket& client) const;
+    bool is_open() const;
+    // the spans are sent as a single message
+    bool send_message(const OutputSpan* spans, size_t count);
+    bool send_message(const void* data, size_t size) {
+        const OutputSpan span{data, size};
+        return send_message(&span, 1);
+    }
+    // false if the peer went away or the message is bigger than max_message_size
+    bool receive_message(Vector<uint8_t>& message);
+    void close();
+    // removes the socket file of a listening socket
+    static void remove(StringView path);
+};
\ No newline at end of file
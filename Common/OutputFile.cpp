@@ -0,0 +1,150 @@
+#include "OutputFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+DiscardResult<FileError> OutputFile::open(const Path& path) {
+    close();
+    HANDLE file = CreateFileW(path.string().data(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { return FileError{"Failed to open file for writing"_s}; }
+    m_handle = file;
+    m_failed = false;
+    m_used = 0;
+    m_buffer.resize(buffer_size);
+    return {};
+}
+
+bool OutputFile::is_open() const {
+    return m_handle != nullptr;
+}
+
+void OutputFile::write_raw(const void* data, size_t size) {
+    const char* src = static_cast<const char*>(data);
+    while (size > 0 && !m_failed) {
+        const DWORD chunk = size > 0x40000000 ? 0x40000000 : static_cast<DWORD>(size);
+        DWORD written = 0;
+        if (!WriteFile(m_handle, src, chunk, &written, nullptr) || written == 0) {
+            m_failed = true;
+            return;
+        }
+        src += written;
+        size -= written;
+    }
+}
+
+// regular files can't do gathered writes without FILE_FLAG_NO_BUFFERING, every span gets its own call
+void OutputFile::write_spans(const OutputSpan* spans, size_t count) {
+    flush();
+    for (size_t i = 0; i < count; ++i) {
+        write_raw(spans[i].data, spans[i].size);
+    }
+}
+
+DiscardResult<FileError> OutputFile::close() {
+    if (m_handle == nullptr) return {};
+    flush();
+    if (!CloseHandle(m_handle)) m_failed = true;
+    m_handle = nullptr;
+    if (m_failed) { return FileError{"Failed to write file"_s}; }
+    return {};
+}
+#else
+DiscardResult<FileError> OutputFile::open(const Path& path) {
+    close();
+    int fd = ::open(path.string().data(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) { return FileError{"Failed to open file for writing"_s}; }
+    m_fd = fd;
+    m_failed = false;
+    m_used = 0;
+    m_buffer.resize(buffer_size);
+    return {};
+}
+
+bool OutputFile::is_open() const {
+    return m_fd >= 0;
+}
+
+void OutputFile::write_raw(const void* data, size_t size) {
+    const char* src = static_cast<const char*>(data);
+    while (size > 0 && !m_failed) {
+        ssize_t written = ::write(m_fd, src, size);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) {
+            m_failed = true;
+            return;
+        }
+        src += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+void OutputFile::write_spans(const OutputSpan* spans, size_t count) {
+    flush();
+    constexpr size_t max_iov = IOV_MAX < 1024 ? IOV_MAX : 1024;
+    iovec iov[max_iov];
+    for (size_t first = 0; first < count && !m_failed;) {
+        const size_t batch = count - first < max_iov ? count - first : max_iov;
+        size_t total = 0;
+        for (size_t i = 0; i < batch; ++i) {
+            iov[i].iov_base = const_cast<void*>(spans[first + i].data);
+            iov[i].iov_len = spans[first + i].size;
+            total += spans[first + i].size;
+        }
+        ssize_t written = ::writev(m_fd, iov, static_cast<int>(batch));
+        if (written < 0 && errno != EINTR) {
+            m_failed = true;
+            return;
+        }
+        // a short write finishes the rest of the batch span by span
+        size_t done = written < 0 ? 0 : static_cast<size_t>(written);
+        if (done < total) {
+            for (size_t i = 0; i < batch; ++i) {
+                const size_t size = spans[first + i].size;
+                if (done >= size) {
+                    done -= size;
+                    continue;
+                }
+                write_raw(static_cast<const char*>(spans[first + i].data) + done, size - done);
+                done = 0;
+            }
+        }
+        first += batch;
+    }
+}
+
+DiscardResult<FileError> OutputFile::close() {
+    if (m_fd < 0) return {};
+    flush();
+    if (::close(m_fd) != 0) m_failed = true;
+    m_fd = -1;
+    if (m_failed) { return FileError{"Failed to write file"_s}; }
+    return {};
+}
+#endif
+
+void OutputFile::write(const void* data, size_t size) {
+    if (size >= m_buffer.size() / 2) {
+        // big blocks skip the copy
+        flush();
+        write_raw(data, size);
+        return;
+    }
+    ARLib::memcpy(reserve(size), data, size);
+    m_used += size;
+}
+
+void OutputFile::flush() {
+    if (m_used == 0) return;
+    write_raw(m_buffer.data(), m_used);
+    m_used = 0;
+}
\ No newline at end of file
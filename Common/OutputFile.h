@@ -0,0 +1,90 @@
+#pragma once
+#include <Array.hpp>
+#include <File.hpp>
+#include <Path.hpp>
+#include <StringView.hpp>
+#include <Types.hpp>
+#include <Vector.hpp>
+
+using namespace ARLib;
+
+struct OutputSpan {
+    const void* data;
+    size_t size;
+};
+
+enum class HexCase { Lower, Upper };
+
+// two characters for every byte value, lower case digits first and upper case ones after them
+constexpr auto hex_byte_table = [] {
+    constexpr char lower[] = "0123456789abcdef";
+    constexpr char upper[] = "0123456789ABCDEF";
+    Array<char, 1024> table{};
+    for (size_t i = 0; i < 256; ++i) {
+        table[i * 2] = lower[i >> 4];
+        table[i * 2 + 1] = lower[i & 0xF];
+        table[512 + i * 2] = upper[i >> 4];
+        table[512 + i * 2 + 1] = upper[i & 0xF];
+    }
+    return table;
+}();
+
+// writes the low digits hex digits of value to out, most significant first
+inline void format_hex(char* out, uint64_t value, size_t digits, HexCase hcase) {
+    const char* table = hex_byte_table.data() + (hcase == HexCase::Upper ? 512 : 0);
+    size_t pos = digits;
+    for (; pos >= 2; pos -= 2) {
+        const size_t byte = static_cast<size_t>(value & 0xFF) * 2;
+        out[pos - 1] = table[byte + 1];
+        out[pos - 2] = table[byte];
+        value >>= 8;
+    }
+    if (pos == 1) out[0] = table[static_cast<size_t>(value & 0xF) * 2 + 1];
+}
+
+// Buffered writer on top of the raw file handle. Text is formatted straight into a large buffer that is written
+// out when full, binary images can be written with a single gathered write instead of going through the buffer.
+// Failures are sticky and reported by close().
+class OutputFile {
+    Vector<char> m_buffer{};
+    size_t m_used = 0;
+    bool m_failed = false;
+#ifdef _WIN32
+    void* m_handle = nullptr;
+#else
+    int m_fd = -1;
+#endif
+    void write_raw(const void* data, size_t size);
+    char* reserve(size_t size) {
+        if (m_buffer.size() - m_used < size) flush();
+        return m_buffer.data() + m_used;
+    }
+
+    public:
+    constexpr static size_t buffer_size = 1024 * 1024;
+    OutputFile() = default;
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+    ~OutputFile() { close(); }
+    DiscardResult<FileError> open(const Path& path);
+    bool is_open() const;
+    void write(const void* data, size_t size);
+    void write(StringView str) { write(str.data(), str.size()); }
+    void put(char c) {
+        *reserve(1) = c;
+        ++m_used;
+    }
+    // value in hex with at least min_digits digits, wider values are never truncated
+    void put_hex(uint64_t value, size_t min_digits, HexCase hcase) {
+        size_t digits = 1;
+        for (uint64_t rest = value >> 4; rest != 0; rest >>= 4)
+            ++digits;
+        if (digits < min_digits) digits = min_digits;
+        format_hex(reserve(digits), value, digits, hcase);
+        m_used += digits;
+    }
+    // flushes the buffer and writes all the spans with as few system calls as possible
+    void write_spans(const OutputSpan* spans, size_t count);
+    void flush();
+    DiscardResult<FileError> close();
+};
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "ThreadPool.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+struct ParallelJob {
+    void (*fn)(const void*, size_t);
+    const void* ctx;
+    size_t count;
+    size_t next;
+};
+
+static size_t claim_index(ParallelJob& job) {
+#ifdef _WIN32
+    return static_cast<size_t>(
+    InterlockedExchangeAdd64(reinterpret_cast<volatile LONG64*>(&job.next), static_cast<LONG64>(1)));
+#else
+    return __atomic_fetch_add(&job.next, static_cast<size_t>(1), __ATOMIC_RELAXED);
+#endif
+}
+
+static void work(ParallelJob& job) {
+    for (size_t idx = claim_index(job); idx < job.count; idx = claim_index(job)) {
+        job.fn(job.ctx, idx);
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker_main(LPVOID arg) {
+    work(*static_cast<ParallelJob*>(arg));
+    return 0;
+}
+#else
+static void* worker_main(void* arg) {
+    work(*static_cast<ParallelJob*>(arg));
+    return nullptr;
+}
+#endif
+
+size_t ThreadPool::hardware_threads() {
+#ifdef _WIN32
+    SYSTEM_INFO info{};
+    GetSystemInfo(&info);
+    long count = static_cast<long>(info.dwNumberOfProcessors);
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return count > 0 ? static_cast<size_t>(count) : 1;
+}
+
+ThreadPool::ThreadPool(size_t threads) : m_size(threads == 0 ? hardware_threads() : threads) {
+    if (m_size > max_threads) m_size = max_threads;
+}
+
+void ThreadPool::run(size_t count, TaskFn fn, const void* ctx) const {
+    ParallelJob job{fn, ctx, count, 0};
+    size_t extra = (m_size < count ? m_size : count);
+    extra = extra > 0 ? extra - 1 : 0;
+#ifdef _WIN32
+    HANDLE threads[max_threads]{};
+#else
+    pthread_t threads[max_threads]{};
+#endif
+    size_t started = 0;
+    for (; started < extra; ++started) {
+#ifdef _WIN32
+        threads[started] = CreateThread(nullptr, 0, worker_main, &job, 0, nullptr);
+        if (threads[started] == nullptr) break;
+#else
+        if (pthread_create(&threads[started], nullptr, worker_main, &job) != 0) break;
+#endif
+    }
+    // if a thread couldn't be started the remaining ones (and this one) pick up its share
+    work(job);
+    for (size_t i = 0; i < started; ++i) {
+#ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], nullptr);
+#endif
+    }
+}
+
+#ifdef _WIN32
+void Mutex::lock() {
+    AcquireSRWLockExclusive(reinterpret_cast<PSRWLOCK>(&m_lock));
+}
+
+void Mutex::unlock() {
+    ReleaseSRWLockExclusive(reinterpret_cast<PSRWLOCK>(&m_lock));
+}
+#else
+void Mutex::lock() {
+    pthread_mutex_lock(&m_lock);
+}
+
+void Mutex::unlock() {
+    pthread_mutex_unlock(&m_lock);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+#include <Types.hpp>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+using namespace ARLib;
+
+// Fork-join worker group sized to the machine. Every parallel_for starts size() - 1 threads, runs the calling thread
+// as the last worker and returns once all of them are joined. Indices are handed out dynamically so uneven tasks
+// still balance.
+class ThreadPool {
+    constexpr static size_t max_threads = 64;
+    size_t m_size;
+    using TaskFn = void (*)(const void*, size_t);
+    template <typename Func>
+    static void invoke(const void* ctx, size_t idx) {
+        (*static_cast<const Func*>(ctx))(idx);
+    }
+    void run(size_t count, TaskFn fn, const void* ctx) const;
+
+    public:
+    // 0 means one thread per hardware thread
+    explicit ThreadPool(size_t threads = 0);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    size_t size() const { return m_size; }
+    // calls func(i) for every i in [0, count)
+    template <typename Func>
+    void parallel_for(size_t count, const Func& func) const {
+        run(count, &invoke<Func>, &func);
+    }
+    static size_t hardware_threads();
+};
+
+// Non-recursive lock for the little state that long-running workers share.
+class Mutex {
+#ifdef _WIN32
+    // an SRWLOCK, which is a single pointer initialized to zero
+    void* m_lock = nullptr;
+#else
+    pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+    public:
+    Mutex() = default;
+    Mutex(const Mutex&) = delete;
+    Mutex& operator=(const Mutex&) = delete;
+    void lock();
+    void unlock();
+};
+
+class LockGuard {
+    Mutex& m_mutex;
+
+    public:
+    explicit LockGuard(Mutex& mutex) : m_mutex(mutex) { m_mutex.lock(); }
+    LockGuard(const LockGuard&) = delete;
+    LockGuard& operator=(const LockGuard&) = delete;
+    ~LockGuard() { m_mutex.unlock(); }
+};
\ No newline at end of file
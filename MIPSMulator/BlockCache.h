@@ -0,0 +1,93 @@
+#pragma once
+#include "CountedLoop.h"
+#include "InstructionParser.h"
+#include <Vector.hpp>
+
+using namespace ARLib;
+
+// A basic block as the run loop enters it, from one instruction to the end of its block
+struct CachedBlock {
+    const DecodedInstruction* first;
+    uint16_t length;
+    // Where the block went the last time it fell through and the last time it branched or jumped, linked the first
+    // time so the next run of the block goes straight there. A branch can land anywhere, its link remembers the pc.
+    uint32_t fall_through;
+    uint32_t taken;
+    uint64_t taken_pc;
+    // times the block was entered, counted by policies with stats
+    uint64_t executions;
+    // what counted_loop() found out, an index in the loops of the cache if it's one
+    uint32_t loop;
+};
+
+// The blocks of the program being run, made the first time the pc gets to them. CPU::run_for() asks for the block
+// following the one it just ran, which is usually a link away, and only looks the pc up when it isn't.
+class BlockCache {
+    Vector<CachedBlock> m_blocks{};
+    // slot + 1 of the block starting at every instruction, 0 until the pc gets there
+    Vector<uint32_t> m_slot_at{};
+    Vector<CountedLoop> m_loops{};
+    const DecodedInstruction* m_code = nullptr;
+    constexpr static uint32_t not_analyzed = ~static_cast<uint32_t>(0);
+    constexpr static uint32_t not_a_loop = not_analyzed - 1;
+
+    uint32_t lookup(uint64_t pc) {
+        const uint64_t index = pc / sizeof(uint32_t);
+        if (index >= m_slot_at.size()) return no_block;
+        if (m_slot_at[index] != 0) return m_slot_at[index] - 1;
+        const DecodedInstruction* first = m_code + index;
+        m_blocks.append(CachedBlock{first, first->block_length, no_block, no_block, 0, 0, not_analyzed});
+        m_slot_at[index] = static_cast<uint32_t>(m_blocks.size());
+        return m_slot_at[index] - 1;
+    }
+
+    public:
+    constexpr static uint32_t no_block = ~static_cast<uint32_t>(0);
+    // forgets every block, for a new program
+    void reset(const DecodedInstruction* code, size_t count) {
+        m_blocks.clear();
+        m_slot_at.clear();
+        m_loops.clear();
+        m_slot_at.resize(count);
+        for (auto& slot : m_slot_at) slot = 0;
+        m_code = code;
+    }
+    // The block at pc, which the block in from led to, falling through or not. no_block when the pc is outside the
+    // program, from is no_block when the run just started.
+    uint32_t next(uint32_t from, uint64_t pc, bool fell_through) {
+        if (from == no_block) return lookup(pc);
+        const CachedBlock& block = m_blocks[from];
+        if (fell_through && block.fall_through != no_block) return block.fall_through;
+        if (!fell_through && block.taken != no_block && block.taken_pc == pc) return block.taken;
+        const uint32_t slot = lookup(pc);
+        if (slot == no_block) return no_block;
+        // looked up again, lookup() can move the blocks
+        CachedBlock& linked = m_blocks[from];
+        if (fell_through) {
+            linked.fall_through = slot;
+        } else {
+            linked.taken = slot;
+            linked.taken_pc = pc;
+        }
+        return slot;
+    }
+    CachedBlock& operator[](uint32_t slot) { return m_blocks[slot]; }
+    // the counted loop the block is, nullptr if it isn't one, analyzed the first time a policy asks
+    const CountedLoop* counted_loop(CachedBlock& block) {
+        if (block.loop == not_analyzed) {
+            CountedLoop loop{};
+            if (CountedLoop::analyze(block.first, block.length, start_pc(block), loop)) {
+                m_loops.append(loop);
+                block.loop = static_cast<uint32_t>(m_loops.size() - 1);
+            } else {
+                block.loop = not_a_loop;
+            }
+        }
+        return block.loop == not_a_loop ? nullptr : &m_loops[block.loop];
+    }
+    const Vector<CachedBlock>& blocks() const { return m_blocks; }
+    // the pc of the first instruction of the block
+    uint64_t start_pc(const CachedBlock& block) const {
+        return static_cast<uint64_t>(block.first - m_code) * sizeof(uint32_t);
+    }
+};
\ No newline at end of file
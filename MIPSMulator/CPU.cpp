@@ -1,18 +1,21 @@
 #include "CPU.h"
+#include "OutputFile.h"
 #include <Console.hpp>
+#include <Printer.hpp>
 #include <cstdio_compat.hpp>
 
-void CPU::run(bool print_instructions) {
-    while (!m_halted) {
-        auto& ins = m_ins_data.instructions[m_pc / sizeof(uint32_t)];
-        ins.decode(*this, print_instructions);
-        dump_state();
-        m_pc += sizeof(uint32_t);
-        m_clock_count++;
+bool parse_count(const String& option, StringView what, uint64_t& value) {
+    if (option.is_empty()) return true;
+    auto count_or_err = StrViewToU64(option.view());
+    if (count_or_err.is_error()) {
+        Printer::print("Invalid {} {}", what, option);
+        return false;
     }
-    dump_memory();
+    value = count_or_err.to_ok();
+    return true;
 }
-void CPU::dump_state() {
+
+void CPU::dump_state() const {
     ARLib::fprintf(m_log_file, "At clock count = %lld, pc = %lld\n", m_clock_count, m_pc);
     for (const auto& [i, t] : enumerate(zip(m_regs, m_freg))) {
         auto [reg, freg] = t;
@@ -20,16 +23,171 @@ void CPU::dump_state() {
     }
 }
 
-void CPU::dump_memory() {
-    File f{Path{"memdump.dat"}};
-    f.open(OpenFileMode::Write);
-    size_t words = m_ro_data.data.size() / sizeof(uint64_t);
-    static char buf[1024];
+// Hash of one line of memory mixed with its index, a memory digest is the sum of the digests of its lines
+static uint64_t line_digest(const uint8_t* bytes, size_t size, size_t line) {
+    uint64_t hash = content_hash(bytes, size) ^ (static_cast<uint64_t>(line) * 0x9E3779B97F4A7C15ull);
+    // splitmix64's finalizer, so that lines with similar hashes don't cancel out in the sum
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+    return hash ^ (hash >> 31);
+}
+static uint64_t line_digest(const Vector<uint8_t>& memory, size_t line) {
+    const size_t offset = line * CPU::dirty_line_size;
+    const size_t rest = memory.size() - offset;
+    return line_digest(memory.data() + offset, rest < CPU::dirty_line_size ? rest : CPU::dirty_line_size, line);
+}
+
+void CPU::reset_memory_tracking() {
+    const size_t lines = line_count();
+    m_dirty.resize((lines + 63) / 64);
+    for (auto& word : m_dirty) word = 0;
+    m_initial_line_digests.resize(lines);
+    m_initial_digest = 0;
+    for (size_t line = 0; line < lines; ++line) {
+        m_initial_line_digests[line] = line_digest(m_ro_data.data, line);
+        m_initial_digest += m_initial_line_digests[line];
+    }
+}
+uint64_t CPU::memory_digest() const {
+    uint64_t digest = m_initial_digest;
+    for (size_t line = 0; line < m_initial_line_digests.size(); ++line) {
+        if (line_dirty(line)) digest += line_digest(m_ro_data.data, line) - m_initial_line_digests[line];
+    }
+    return digest;
+}
+uint64_t CPU::memory_digest(const Vector<uint8_t>& memory) {
+    uint64_t digest = 0;
+    const size_t lines = (memory.size() + dirty_line_size - 1) / dirty_line_size;
+    for (size_t line = 0; line < lines; ++line) digest += line_digest(memory, line);
+    return digest;
+}
+
+static void put_word(OutputFile& out, const Vector<uint8_t>& memory, size_t offset) {
+    uint64_t val = 0;
+    ARLib::memcpy(&val, memory.data() + offset, sizeof(uint64_t));
+    out.put_hex(offset, 4, HexCase::Upper);
+    out.put(' ');
+    out.put_hex(val, 16, HexCase::Upper);
+    out.put('\n');
+}
+void CPU::dump_memory(MemoryDumpFormat format) const {
+    switch (format) {
+    case MemoryDumpFormat::Full:
+        dump_memory(m_ro_data.data);
+        break;
+    case MemoryDumpFormat::Modified:
+        dump_modified_memory();
+        break;
+    case MemoryDumpFormat::BinaryDiff:
+        dump_memory_diff();
+        break;
+    }
+}
+void CPU::dump_memory(const Vector<uint8_t>& memory) {
+    OutputFile out{};
+    if (out.open(Path{"memdump.dat"}).is_error()) return;
+    size_t words = memory.size() / sizeof(uint64_t);
+    for (size_t i = 0; i < words; i++) put_word(out, memory, i * sizeof(uint64_t));
+}
+void CPU::dump_modified_memory() const {
+    OutputFile out{};
+    if (out.open(Path{"memdump.dat"}).is_error()) return;
+    const Vector<uint8_t>& memory = m_ro_data.data;
+    size_t words = memory.size() / sizeof(uint64_t);
     for (size_t i = 0; i < words; i++) {
-        buf[0] = '\0';
-        uint64_t val = 0;
-        ARLib::memcpy(&val, m_ro_data.data_raw() + (i * sizeof(uint64_t)), sizeof(uint64_t));
-        size_t sz = static_cast<size_t>(ARLib::snprintf(buf, sizeof(buf), "%04X %016llX\n", i * sizeof(uint64_t), val));
-        f.write(String{buf, sz});
+        const size_t offset = i * sizeof(uint64_t);
+        if (line_dirty(offset / dirty_line_size)) put_word(out, memory, offset);
+    }
+}
+void CPU::dump_memory_diff() const {
+    OutputFile out{};
+    if (out.open(Path{"memdump.diff"}).is_error()) return;
+    const Vector<uint8_t>& memory = m_ro_data.data;
+    const uint32_t line_size = dirty_line_size;
+    const uint64_t memory_size = memory.size();
+    const uint64_t digest = memory_digest();
+    out.write("MDIF"_sv);
+    out.write(&line_size, sizeof(line_size));
+    out.write(&memory_size, sizeof(memory_size));
+    out.write(&digest, sizeof(digest));
+    const size_t lines = line_count();
+    for (size_t line = 0; line < lines;) {
+        if (!line_dirty(line)) {
+            ++line;
+            continue;
+        }
+        size_t end = line + 1;
+        while (end < lines && line_dirty(end)) ++end;
+        const uint64_t offset = line * dirty_line_size;
+        const uint64_t limit = end * dirty_line_size;
+        const uint64_t size = (limit < memory_size ? limit : memory_size) - offset;
+        out.write(&offset, sizeof(offset));
+        out.write(&size, sizeof(size));
+        out.write(memory.data() + offset, static_cast<size_t>(size));
+        line = end;
+    }
+}
+static void print_line(const char* buf, int ret) {
+    if (ret <= 0) return;
+    Printer::print("{}", StringView{buf, static_cast<size_t>(ret)});
+}
+
+void CPU::print_result(StopReason reason, const CPUState& state, uint64_t memory_digest) {
+    char buf[128]{};
+    switch (reason) {
+    case StopReason::Halted:
+        Printer::print("Program halted after {} instructions", state.clock_count);
+        break;
+    case StopReason::StepLimit:
+        Printer::print("Program stopped after {} instructions, the limit", state.clock_count);
+        break;
+    case StopReason::PcOutOfRange:
+        Printer::print("Program stopped after {} instructions, the pc left the code", state.clock_count);
+        break;
+    case StopReason::BadAddress:
+        Printer::print("Program stopped after {} instructions, the load or store at the pc is outside the memory",
+                       state.clock_count);
+        break;
+    case StopReason::CycleLimit:
+        Printer::print("Program stopped after {} instructions, the cycle limit", state.clock_count);
+        break;
+    case StopReason::TimeLimit:
+        Printer::print("Program stopped after {} instructions, the time limit", state.clock_count);
+        break;
+    }
+    int ret = ARLib::snprintf(buf, sizeof(buf), "pc = %lld, fp flag = %u, memory digest = %016llX",
+                              static_cast<long long>(state.pc), state.fp_flag ? 1u : 0u,
+                              static_cast<unsigned long long>(memory_digest));
+    print_line(buf, ret);
+    for (int i = 0; i < 32; ++i) {
+        ret = ARLib::snprintf(buf, sizeof(buf), "\tr%-2d = %016llX    f%-2d = %016.8lf", i,
+                              static_cast<unsigned long long>(state.regs[i]), i, state.fregs[i]);
+        print_line(buf, ret);
+    }
+}
+void CPU::print_stats(StopReason reason) const {
+    Printer::print("Stopped by {} after {} instructions in {} cycles, exit status {}", enum_to_str_view(reason),
+                   m_clock_count, m_cycles, exit_status(reason));
+    for (size_t i = 0; i < m_executed.size(); ++i) {
+        if (m_executed[i] == 0) continue;
+        Printer::print("\t{}: {}", isa_table[i].name, m_executed[i]);
+    }
+    // the hottest blocks first, picked one at a time since only a few are printed
+    constexpr size_t hot_block_count = 10;
+    const auto& blocks = m_blocks.blocks();
+    Array<size_t, hot_block_count> printed{};
+    for (size_t n = 0; n < hot_block_count; ++n) {
+        size_t hottest = blocks.size();
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            bool seen = false;
+            for (size_t p = 0; p < n; ++p) seen = seen || printed[p] == i;
+            if (seen || blocks[i].executions == 0) continue;
+            if (hottest == blocks.size() || blocks[i].executions > blocks[hottest].executions) hottest = i;
+        }
+        if (hottest == blocks.size()) break;
+        printed[n] = hottest;
+        const CachedBlock& block = blocks[hottest];
+        Printer::print("\tblock at pc {}, {} instructions: entered {} times", m_blocks.start_pc(block), block.length,
+                       block.executions);
     }
 }
\ No newline at end of file
@@ -1,29 +1,186 @@
 #pragma once
+#include "BlockCache.h"
+#include "Bytes.h"
+#include "Clock.h"
 #include "DataParser.h"
+#include "ExecutionPolicy.h"
 #include "InstructionParser.h"
 #include <Array.hpp>
+#include <String.hpp>
+#include <StringView.hpp>
 
+// Why run_for() returned
+MAKE_FANCY_ENUM(StopReason, uint32_t, Halted, StepLimit, PcOutOfRange, BadAddress, CycleLimit, TimeLimit);
+
+// Exit status of the errors that keep a program from running at all
+constexpr int error_exit_status = 1;
+// Exit status of a process whose program stopped for the reason, every reason has its own
+constexpr int exit_status(StopReason reason) {
+    return reason == StopReason::Halted ? 0 : static_cast<int>(ToUnderlying(reason)) + 1;
+}
+
+// When run_for() gives up on a program that doesn't halt. The step budget is exact, the cycle budget and the
+// deadline are only looked at between basic blocks so a run can go past them by the rest of a block.
+struct RunLimits {
+    uint64_t max_steps = ~static_cast<uint64_t>(0);
+    // cycles according to the timing model of the policy
+    uint64_t max_cycles = ~static_cast<uint64_t>(0);
+    // wall-clock time, 0 for no limit
+    uint64_t time_limit_ms = 0;
+};
+// Parses a command line option giving one of the limits, an empty option leaves the value alone. Prints what's
+// wrong with it and returns false when it isn't a number.
+bool parse_count(const String& option, StringView what, uint64_t& value);
+
+// What dump_memory() writes
+enum class MemoryDumpFormat : uint8_t {
+    // every word of the memory to memdump.dat
+    Full,
+    // only the words of the lines the program wrote to, to memdump.dat in the same format
+    Modified,
+    // The lines the program wrote to, to memdump.diff: "MDIF", the uint32_t line size, the uint64_t memory size and
+    // memory_digest(), then for every run of consecutive written lines its uint64_t offset and size and its bytes
+    BinaryDiff
+};
+
+// Registers and counters of a CPU, as a run left them
+struct CPUState {
+    uint64_t pc;
+    uint64_t clock_count;
+    Array<uint64_t, 32> regs;
+    Array<double, 32> fregs;
+    bool fp_flag;
+    bool halted;
+};
+
+class NativeProgram;
+
+// The emulator proper, usable on its own from the MIPSMulatorCore library. A program is loaded either from files
+// with initialize() or from memory with load(), run_for() runs it without touching the filesystem and the state and
+// the memory can be inspected afterwards. Only run() and the logging constructor write dump.txt and memdump.dat.
 class CPU {
+    // runs translated code on the registers and the memory directly
+    friend class NativeProgram;
     InstructionData m_ins_data;
     BinaryData m_ro_data;
+    // the program being run, either m_ins_data or one owned by whoever called load()
+    const DecodedInstruction* m_code = nullptr;
+    size_t m_code_size = 0;
+    // the blocks of m_code the program ran so far, linked to each other
+    BlockCache m_blocks{};
     uint64_t m_pc{0};
     Array<uint64_t, 32> m_regs{};
     Array<double, 32> m_freg{};
     bool m_fp_flag = false;
     bool m_halted = false;
-    uint64_t m_clock_count{0}; // inaccurate for now
+    uint64_t m_clock_count{0};
+    // according to the timing model of the policies the program ran with
+    uint64_t m_cycles{0};
+    // times every row of isa_table was executed, only counted by policies with stats
+    Array<uint64_t, isa_table.size()> m_executed{};
+    // set by a checked load or store outside the memory
+    bool m_bad_address = false;
+    // one bit per dirty_line_size bytes of memory, set by every write since the program was loaded
+    Vector<uint64_t> m_dirty{};
+    // the digest of every line as the program was loaded, and their sum
+    Vector<uint64_t> m_initial_line_digests{};
+    uint64_t m_initial_digest = 0;
     FILE* m_log_file = nullptr;
+    template <size_t S, bool Checked>
+    bool accessible(uint64_t addr) {
+        if constexpr (Checked) {
+            const size_t size = m_ro_data.data.size();
+            if (addr > size || size - addr < S) {
+                m_bad_address = true;
+                return false;
+            }
+        }
+        return true;
+    }
+    void mark_dirty(uint64_t addr, size_t size) {
+        const uint64_t first = addr / dirty_line_size;
+        const uint64_t last = (addr + size - 1) / dirty_line_size;
+        m_dirty[first / 64] |= 1ull << (first % 64);
+        m_dirty[last / 64] |= 1ull << (last % 64);
+    }
+    void reset_memory_tracking();
+    void dump_modified_memory() const;
+    void dump_memory_diff() const;
+    // Skips iterations of the counted loop the pc is at the start of and accounts for them as if they ran. It stops
+    // short of the iteration whose branch falls through and of any iteration run_for() would have stopped before
+    // with the steps, cycles and clock check left, and the iteration after the skipped ones has to run whole since
+    // it sets the registers the loop doesn't carry. Returns the steps skipped.
+    template <typename Policy>
+    uint64_t skip_iterations(const CountedLoop& loop, CachedBlock& block, uint64_t steps_left, uint64_t cycles_left,
+                             uint64_t steps_to_clock_check) {
+        const uint64_t length = block.length;
+        uint64_t cycles = 0;
+        for (size_t i = 0; i < length; ++i) cycles += Policy::TimingModel::cycles(block.first[i].id);
+        if (steps_left / length < 2) return 0;
+        uint64_t most = steps_left / length - 1;
+        if ((cycles_left - 1) / cycles < most) most = (cycles_left - 1) / cycles;
+        if ((steps_to_clock_check - 1) / length < most) most = (steps_to_clock_check - 1) / length;
+        const uint64_t skipped = loop.skip(m_regs, most);
+        m_clock_count += skipped * length;
+        m_cycles += skipped * cycles;
+        if constexpr (Policy::stats) {
+            block.executions += skipped;
+            for (size_t i = 0; i < length; ++i) {
+                if (block.first[i].id < m_executed.size()) m_executed[block.first[i].id] += skipped;
+            }
+        }
+        return skipped * length;
+    }
+    template <typename Policy>
+    void account(uint8_t id) {
+        if constexpr (Policy::stats) {
+            if (id < m_executed.size()) m_executed[id]++;
+        }
+        m_cycles += Policy::TimingModel::cycles(id);
+    }
 
     public:
-    CPU() {
+    // granularity of the write tracking, a cache line
+    constexpr static size_t dirty_line_size = 64;
+    // with log_state every step run() takes is written to dump.txt
+    explicit CPU(bool log_state = false) {
+        if (!log_state) return;
         FsString p{"dump.txt"};
         m_log_file = fopen(p.data(), "w");
     }
+    CPU(const CPU&) = delete;
+    CPU& operator=(const CPU&) = delete;
     DiscardResult<FileError> initialize(const Path& ins_data, const Path& ro_data) {
         TRY(m_ins_data.load(ins_data));
         TRY(m_ro_data.load(ro_data));
+        m_code = m_ins_data.instructions.data();
+        m_code_size = m_ins_data.instructions.size();
+        m_blocks.reset(m_code, m_code_size);
+        reset_memory_tracking();
         return {};
     }
+    // Starts over on an already loaded program, which has to outlive the run. The data is copied since the program
+    // writes to it.
+    void load(const DecodedInstruction* code, size_t count, const BinaryData& data) {
+        m_code = code;
+        m_code_size = count;
+        m_ro_data.data.resize(data.data.size());
+        if (data.data.size() > 0) ARLib::memcpy(m_ro_data.data.data(), data.data.data(), data.data.size());
+        m_pc = 0;
+        m_regs = Array<uint64_t, 32>{};
+        m_freg = Array<double, 32>{};
+        m_fp_flag = false;
+        m_halted = false;
+        m_clock_count = 0;
+        m_cycles = 0;
+        m_executed = Array<uint64_t, isa_table.size()>{};
+        m_bad_address = false;
+        m_blocks.reset(m_code, m_code_size);
+        reset_memory_tracking();
+    }
+    void load(const InstructionData& program, const BinaryData& data) {
+        load(program.instructions.data(), program.instructions.size(), data);
+    }
     uint64_t reg(Integral auto reg) const { return m_regs[static_cast<uint32_t>(reg)]; }
     void reg(Integral auto reg, Integral auto val) { m_regs[static_cast<uint32_t>(reg)] = static_cast<uint64_t>(val); }
     double freg(Integral auto reg) const { return m_freg[static_cast<uint32_t>(reg)]; }
@@ -37,44 +194,47 @@ class CPU {
         m_pc = static_cast<uint64_t>(pc);
     }
     void set_pc(uint64_t new_pc) { m_pc = new_pc; }
-    template <size_t S>
+    // Checked accesses outside the memory read 0 and don't write anything, the run stops after the instruction
+    template <size_t S, bool Checked = false>
     auto read(uint64_t addr) {
         if constexpr (S == 1) {
             uint8_t val = 0;
-            ARLib::memcpy(&val, m_ro_data.data_raw() + addr, sizeof(uint8_t));
+            if (accessible<S, Checked>(addr)) ARLib::memcpy(&val, m_ro_data.data_raw() + addr, sizeof(uint8_t));
             return val;
         } else if constexpr (S == 2) {
             uint16_t val = 0;
-            ARLib::memcpy(&val, m_ro_data.data_raw() + addr, sizeof(uint16_t));
+            if (accessible<S, Checked>(addr)) ARLib::memcpy(&val, m_ro_data.data_raw() + addr, sizeof(uint16_t));
             return val;
         } else if constexpr (S == 4) {
             uint32_t val = 0;
-            ARLib::memcpy(&val, m_ro_data.data_raw() + addr, sizeof(uint32_t));
+            if (accessible<S, Checked>(addr)) ARLib::memcpy(&val, m_ro_data.data_raw() + addr, sizeof(uint32_t));
             return val;
         } else if constexpr (S == 8) {
             uint64_t val = 0;
-            ARLib::memcpy(&val, m_ro_data.data_raw() + addr, sizeof(uint64_t));
+            if (accessible<S, Checked>(addr)) ARLib::memcpy(&val, m_ro_data.data_raw() + addr, sizeof(uint64_t));
             return val;
         } else {
             COMPTIME_ASSERT("Invalid size");
         }
     }
-    template <size_t S>
+    template <size_t S, bool Checked = false>
     auto readf(uint64_t addr) {
         if constexpr (S == 4) {
             float val = 0;
-            memcpy(&val, m_ro_data.data_raw() + addr, sizeof(float));
+            if (accessible<S, Checked>(addr)) ARLib::memcpy(&val, m_ro_data.data_raw() + addr, sizeof(float));
             return val;
         } else if constexpr (S == 8) {
             double val = 0;
-            ARLib::memcpy(&val, m_ro_data.data_raw() + addr, sizeof(double));
+            if (accessible<S, Checked>(addr)) ARLib::memcpy(&val, m_ro_data.data_raw() + addr, sizeof(double));
             return val;
         } else {
             COMPTIME_ASSERT("Invalid size");
         }
     }
-    template <size_t S>
+    template <size_t S, bool Checked = false>
     void write(uint64_t addr, Integral auto val) {
+        if (!accessible<S, Checked>(addr)) return;
+        mark_dirty(addr, S);
         if constexpr (S == 1) {
             m_ro_data.data[addr] = static_cast<uint8_t>(val);
         } else if constexpr (S == 2) {
@@ -100,24 +260,110 @@ class CPU {
     }
     bool fpflag() const { return m_fp_flag; }
     void fpflag(bool val) { m_fp_flag = val; }
-    template <size_t S>
+    template <size_t S, bool Checked = false>
     void writef(uint64_t addr, FloatingPoint auto val) {
         if constexpr (S == 4) {
             uint32_t v = BitCast(val);
-            write<4>(addr, v);
+            write<4, Checked>(addr, v);
         } else if constexpr (S == 8) {
             uint64_t v = BitCast<uint64_t>(val);
-            write<8>(addr, v);
+            write<8, Checked>(addr, v);
         } else {
             COMPTIME_ASSERT("Invalid size");
         }
     }
     void halt() { m_halted = true; }
-    auto memory() const { return m_ro_data.data; }
-    void run(bool print_instructions);
-    void dump_state();
-    void dump_memory();
+    bool halted() const { return m_halted; }
+    uint64_t clock_count() const { return m_clock_count; }
+    const Array<uint64_t, 32>& regs() const { return m_regs; }
+    const Array<double, 32>& fregs() const { return m_freg; }
+    const Vector<uint8_t>& memory() const { return m_ro_data.data; }
+    size_t line_count() const { return (m_ro_data.data.size() + dirty_line_size - 1) / dirty_line_size; }
+    // the program wrote to the line since it was loaded, even if it wrote back what was there
+    bool line_dirty(size_t line) const { return (m_dirty[line / 64] >> (line % 64)) & 1; }
+    // Equal memories have equal digests, however they got there. Only the lines written since the program was
+    // loaded are hashed, the others keep the digest they had then.
+    uint64_t memory_digest() const;
+    // memory_digest() of a CPU with this memory
+    static uint64_t memory_digest(const Vector<uint8_t>& memory);
+    CPUState state() const { return CPUState{m_pc, m_clock_count, m_regs, m_freg, m_fp_flag, m_halted}; }
+    uint64_t cycles() const { return m_cycles; }
+    // Runs the program with the policy until it stops, writing every step to dump.txt and then dumping the memory
+    template <typename Policy = FastPolicy>
+    StopReason run(const RunLimits& limits = {}, MemoryDumpFormat dump_format = MemoryDumpFormat::Full) {
+        const auto log_step = [](const CPU& cpu) { cpu.dump_state(); };
+        const StopReason reason = run_for<Policy>(limits, log_step);
+        dump_memory(dump_format);
+        return reason;
+    }
+    // Runs the program within the limits without logging anything, calling on_step(*this) after each instruction.
+    // Also stops when the pc leaves the program instead of reading past it and, with a checked policy, on a load or
+    // store outside the memory, leaving the pc on that instruction. The pc and the limits are only checked when a
+    // basic block starts, the instructions of a block run back to back and the next block is found through the
+    // links of the one that ran.
+    template <typename Policy = FastPolicy, typename Func>
+    StopReason run_for(const RunLimits& limits, Func&& on_step) {
+        // reading the clock costs more than a block, the deadline is only looked at every so many instructions
+        constexpr uint64_t clock_check_interval = 1 << 16;
+        const uint64_t deadline = limits.time_limit_ms == 0 ? 0 : monotonic_ns() + limits.time_limit_ms * 1'000'000;
+        const uint64_t start_cycles = m_cycles;
+        uint64_t next_clock_check = m_clock_count + clock_check_interval;
+        uint64_t steps_left = limits.max_steps;
+        uint32_t slot = BlockCache::no_block;
+        // where the pc is if the last block didn't branch
+        uint64_t fall_through_pc = 0;
+        while (!m_halted) {
+            if (steps_left == 0) return StopReason::StepLimit;
+            slot = m_blocks.next(slot, m_pc, m_pc == fall_through_pc);
+            if (slot == BlockCache::no_block) return StopReason::PcOutOfRange;
+            if (m_cycles - start_cycles >= limits.max_cycles) return StopReason::CycleLimit;
+            if (deadline != 0 && m_clock_count >= next_clock_check) {
+                if (monotonic_ns() >= deadline) return StopReason::TimeLimit;
+                next_clock_check = m_clock_count + clock_check_interval;
+            }
+            CachedBlock& block = m_blocks[slot];
+            if constexpr (Policy::fast_forward) {
+                const CountedLoop* loop = m_blocks.counted_loop(block);
+                if (loop != nullptr && m_pc == m_blocks.start_pc(block)) {
+                    const uint64_t to_clock_check = deadline == 0 ? ~static_cast<uint64_t>(0)
+                                                                  : next_clock_check - m_clock_count;
+                    const uint64_t cycles_left = limits.max_cycles - (m_cycles - start_cycles);
+                    steps_left -= skip_iterations<Policy>(*loop, block, steps_left, cycles_left, to_clock_check);
+                }
+            }
+            if constexpr (Policy::stats) block.executions++;
+            const DecodedInstruction* ins = block.first;
+            const uint64_t length = block.length < steps_left ? block.length : steps_left;
+            steps_left -= length;
+            fall_through_pc = m_pc + length * sizeof(uint32_t);
+            for (const DecodedInstruction* end = ins + length; ins != end; ++ins) {
+                ins->execute<Policy>(*this);
+                if constexpr (Policy::checked_memory) {
+                    if (m_bad_address) return StopReason::BadAddress;
+                }
+                on_step(static_cast<const CPU&>(*this));
+                account<Policy>(ins->id);
+                m_pc += sizeof(uint32_t);
+                m_clock_count++;
+            }
+        }
+        return StopReason::Halted;
+    }
+    template <typename Policy = FastPolicy>
+    StopReason run_for(const RunLimits& limits) {
+        return run_for<Policy>(limits, [](const CPU&) {});
+    }
+    void dump_state() const;
+    void dump_memory(MemoryDumpFormat format = MemoryDumpFormat::Full) const;
+    // writes all of the memory to memdump.dat
+    static void dump_memory(const Vector<uint8_t>& memory);
+    // prints why the run stopped, the pc, the flag and the registers
+    static void print_result(StopReason reason, const CPUState& state, uint64_t memory_digest);
+    // prints why the run stopped, the cycle count, how many times every instruction was executed and the blocks
+    // entered the most, counted by policies with stats
+    void print_stats(StopReason reason) const;
     ~CPU() {
         if (m_log_file) ARLib::fclose(m_log_file);
     }
-};
\ No newline at end of file
+};
+#include "Execute.h"
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include "CountedLoop.h"
+
+// The registers of an iteration in progress as linear forms of the registers when it started
+struct SymbolicRegisters {
+    Array<LinearForm, 32> values{};
+    Array<bool, 32> written{};
+    // read before the iteration wrote them, their value comes from the iteration before
+    Array<bool, 32> read_first{};
+    SymbolicRegisters() {
+        for (size_t i = 0; i < values.size(); ++i) values[i].coefficients[i] = 1;
+    }
+    LinearForm read(int32_t reg) {
+        if (!written[reg]) read_first[reg] = true;
+        return values[reg];
+    }
+    void write(int32_t reg, const LinearForm& value) {
+        values[reg] = value;
+        written[reg] = true;
+    }
+};
+
+static LinearForm not_linear() {
+    LinearForm form{};
+    form.linear = false;
+    return form;
+}
+static LinearForm add(const LinearForm& a, const LinearForm& b) {
+    if (!a.linear || !b.linear) return not_linear();
+    LinearForm sum{};
+    for (size_t i = 0; i < sum.coefficients.size(); ++i) sum.coefficients[i] = a.coefficients[i] + b.coefficients[i];
+    sum.constant = a.constant + b.constant;
+    return sum;
+}
+static LinearForm subtract(const LinearForm& a, const LinearForm& b) {
+    if (!a.linear || !b.linear) return not_linear();
+    LinearForm difference{};
+    for (size_t i = 0; i < difference.coefficients.size(); ++i)
+        difference.coefficients[i] = a.coefficients[i] - b.coefficients[i];
+    difference.constant = a.constant - b.constant;
+    return difference;
+}
+static LinearForm add_constant(LinearForm a, uint64_t value) {
+    a.constant += value;
+    return a;
+}
+static LinearForm shift_left(LinearForm a, uint32_t shamt) {
+    for (auto& c : a.coefficients) c <<= shamt;
+    a.constant <<= shamt;
+    return a;
+}
+
+bool CountedLoop::analyze(const DecodedInstruction* first, uint16_t length, uint64_t pc, CountedLoop& loop) {
+    if (length == 0) return false;
+    SymbolicRegisters regs{};
+    // the same fields the handlers in Execute.h decode
+    for (size_t i = 0; i + 1 < length; ++i) {
+        const uint32_t opcode = first[i].opcode;
+        const int32_t rs = (opcode >> 21) & 0x1F;
+        const int32_t rt = (opcode >> 16) & 0x1F;
+        const int32_t rd = (opcode >> 11) & 0x1F;
+        const uint64_t imm = static_cast<uint64_t>(static_cast<int16_t>(opcode & 0xffff));
+        const uint32_t shamt = (opcode >> 6) & 0b11111;
+        switch (static_cast<Instruction>(first[i].id)) {
+        case Instruction::AddImmediate:
+        case Instruction::AddImmediateUnsigned:
+            regs.write(rt, add_constant(regs.read(rs), imm));
+            break;
+        case Instruction::Add:
+        case Instruction::AddUnsigned:
+            regs.write(rd, add(regs.read(rs), regs.read(rt)));
+            break;
+        case Instruction::Subtract:
+        case Instruction::SubtractUnsigned:
+            regs.write(rd, subtract(regs.read(rs), regs.read(rt)));
+            break;
+        case Instruction::ShiftLefLogical:
+            regs.write(rd, shift_left(regs.read(rs), shamt));
+            break;
+        case Instruction::Nop:
+            break;
+        // everything else is fine as long as nothing carried from one iteration to the next comes out of it
+        case Instruction::LogicalAndImmediate:
+        case Instruction::LogicalOrImmediate:
+        case Instruction::LogicalXorImmediate:
+        case Instruction::SetLessThanImmediate:
+        case Instruction::SetLessThanImmediateUnsigned:
+            regs.read(rs);
+            regs.write(rt, not_linear());
+            break;
+        case Instruction::LoadUpperImmediate:
+            regs.read(rt);
+            regs.write(rt, not_linear());
+            break;
+        case Instruction::ShiftRightLogical:
+        case Instruction::ShiftRightArithmetic:
+            regs.read(rs);
+            regs.write(rd, not_linear());
+            break;
+        case Instruction::ShiftLeftByVar:
+        case Instruction::ShiftRightByVar:
+        case Instruction::ShiftRightArithByVar:
+        case Instruction::LogicalAnd:
+        case Instruction::LogicalOr:
+        case Instruction::LogicalXor:
+        case Instruction::SetLessThan:
+        case Instruction::SetLessThanUnsigned:
+        case Instruction::Multiply:
+        case Instruction::MultiplyUnsigned:
+        case Instruction::Divide:
+        case Instruction::DivideUnsigned:
+            regs.read(rs);
+            regs.read(rt);
+            regs.write(rd, not_linear());
+            break;
+        default:
+            // memory, floating point, conditional moves and anything that moves the pc
+            return false;
+        }
+    }
+    const uint32_t opcode = first[length - 1].opcode;
+    const int32_t rs = (opcode >> 21) & 0x1F;
+    const int32_t rt = (opcode >> 16) & 0x1F;
+    int16_t w = static_cast<int16_t>(opcode & 0xffff);
+    const uint64_t branch_pc = pc + (length - 1) * sizeof(uint32_t);
+    LinearForm condition{};
+    switch (static_cast<Instruction>(first[length - 1].id)) {
+    case Instruction::BranchIfNotZero:
+        w *= 4;
+        condition = regs.read(rt);
+        break;
+    case Instruction::BranchIfNotEqual:
+        condition = subtract(regs.read(rs), regs.read(rt));
+        break;
+    default:
+        return false;
+    }
+    // where CPU::move_pc() and the increment after the branch take the pc
+    if (branch_pc + static_cast<uint64_t>(static_cast<int64_t>(w)) + sizeof(uint32_t) != pc) return false;
+    if (!condition.linear) return false;
+    loop.m_carried.clear();
+    for (size_t reg = 0; reg < regs.values.size(); ++reg) {
+        if (!regs.written[reg] || !regs.read_first[reg]) continue;
+        LinearForm stride = regs.values[reg];
+        if (!stride.linear || stride.coefficients[reg] != 1) return false;
+        stride.coefficients[reg] = 0;
+        for (size_t other = 0; other < regs.values.size(); ++other) {
+            if (regs.written[other] && stride.coefficients[other] != 0) return false;
+        }
+        loop.m_carried.append(Carried{static_cast<uint8_t>(reg), stride});
+    }
+    loop.m_condition = condition;
+    return true;
+}
+
+// inverse of an odd number modulo 2^64, every step of Newton's iteration doubles the bits that are right
+static uint64_t inverse(uint64_t odd) {
+    uint64_t x = odd;
+    for (size_t i = 0; i < 5; ++i) x *= 2 - odd * x;
+    return x;
+}
+// the smallest k with a + b * k == 0 modulo 2^64, ~0 when there's none
+static uint64_t first_zero(uint64_t a, uint64_t b) {
+    if (a == 0) return 0;
+    if (b == 0) return ~static_cast<uint64_t>(0);
+    // b = odd * 2^shift, a has to be a multiple of 2^shift too and k is only unique modulo 2^(64 - shift)
+    size_t shift = 0;
+    while (((b >> shift) & 1) == 0) ++shift;
+    if ((a & ((static_cast<uint64_t>(1) << shift) - 1)) != 0) return ~static_cast<uint64_t>(0);
+    const uint64_t k = ((0 - a) >> shift) * inverse(b >> shift);
+    return shift == 0 ? k : k & (~static_cast<uint64_t>(0) >> shift);
+}
+
+uint64_t CountedLoop::skip(Array<uint64_t, 32>& regs, uint64_t max_iterations) const {
+    Array<uint64_t, 32> strides{};
+    for (const auto& carried : m_carried) strides[carried.reg] = carried.stride.evaluate(regs);
+    // the branch of iteration k compares start + step * k
+    const uint64_t start = m_condition.evaluate(regs);
+    uint64_t step = 0;
+    for (const auto& carried : m_carried) step += m_condition.coefficients[carried.reg] * strides[carried.reg];
+    const uint64_t left = first_zero(start, step);
+    const uint64_t count = left < max_iterations ? left : max_iterations;
+    for (const auto& carried : m_carried) regs[carried.reg] += count * strides[carried.reg];
+    return count;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include "InstructionParser.h"
+#include <Array.hpp>
+#include <Vector.hpp>
+
+using namespace ARLib;
+
+// constant + sum of coefficients[r] * r over the registers as an iteration of a loop starts, modulo 2^64
+struct LinearForm {
+    Array<uint64_t, 32> coefficients{};
+    uint64_t constant = 0;
+    // false once an operation that isn't linear, like an and or a compare, went into the value
+    bool linear = true;
+    uint64_t evaluate(const Array<uint64_t, 32>& regs) const {
+        uint64_t value = constant;
+        for (size_t i = 0; i < coefficients.size(); ++i) value += coefficients[i] * regs[i];
+        return value;
+    }
+};
+
+// A loop that is a single basic block branching back to its own start with bnez or bne, only running integer
+// instructions that don't touch the memory. Every register it reads before writing either isn't written at all or
+// grows by the same amount each iteration, and what the branch compares is linear in those registers. The number
+// of iterations left and the registers after them then have a closed form, and CPU::run_for() with a fast forward
+// policy skips the iterations instead of running them.
+class CountedLoop {
+    struct Carried {
+        uint8_t reg;
+        // what an iteration adds to the register, linear in the registers the loop doesn't write
+        LinearForm stride;
+    };
+    Vector<Carried> m_carried{};
+    // the loop goes on while this isn't 0
+    LinearForm m_condition{};
+
+    public:
+    // Finds out if the block of length instructions starting at pc is a counted loop. The register values don't
+    // matter, only the code.
+    static bool analyze(const DecodedInstruction* first, uint16_t length, uint64_t pc, CountedLoop& loop);
+    // Skips up to max_iterations iterations of the loop starting with the registers, but never the one whose branch
+    // falls through, and updates the registers it carries. Registers the loop writes without reading first keep
+    // their values, the next iteration sets them. Returns the number of iterations skipped.
+    uint64_t skip(Array<uint64_t, 32>& regs, uint64_t max_iterations) const;
+};
\ No newline at end of file
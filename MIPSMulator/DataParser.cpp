@@ -1,21 +1,27 @@
 #include "DataParser.h"
 
 DiscardResult<FileError> BinaryData::load(const Path& p) {
-    constexpr size_t wordline_sz = sizeof(uint64_t);
     auto lines_or_error = File::read_all(p);
     if (lines_or_error.is_error()) { return FileError{lines_or_error.to_error()}; }
-    auto filedata = lines_or_error.to_ok();
-    data.reserve(filedata.size() * wordline_sz);
-    for (const auto& [idx, val] : filedata.view()
-                                  .split("\n")
-                                  .iter()
-                                  .filter(&StringView::size)
-                                  .map([](const auto& l) { return MUST(StrViewToU64Hexadecimal(l)); })
-                                  .enumerate()) {
+    return load_text(lines_or_error.to_ok());
+}
+DiscardResult<FileError> BinaryData::load_text(const String& text) {
+    constexpr size_t wordline_sz = sizeof(uint64_t);
+    data.clear();
+    data.reserve(text.size() * wordline_sz);
+    for (const auto& line : text.view().split("\n")) {
+        if (line.size() == 0) continue;
+        TRY_SET(val, StrViewToU64Hexadecimal(line));
         for (size_t i = 0; i < wordline_sz; i++) {
             data.append((val >> (i * wordline_sz)) & 0xFF);
         }
     }
-    data.resize(0x400);
+    data.resize(memory_size);
     return {};
+}
+void BinaryData::load_image(const uint8_t* bytes, size_t size) {
+    if (size > memory_size) size = memory_size;
+    data.clear();
+    data.resize(memory_size);
+    if (size > 0) ARLib::memcpy(data.data(), bytes, size);
 }
\ No newline at end of file
@@ -8,8 +8,14 @@
 using namespace ARLib;
 
 struct BinaryData {
+    // the data memory of the CPU, longer images are cut and shorter ones padded with zeros
+    constexpr static size_t memory_size = 0x400;
     Vector<uint8_t> data;
     BinaryData() = default;
     DiscardResult<FileError> load(const Path& p);
+    // same as load() on a file with these contents
+    DiscardResult<FileError> load_text(const String& text);
+    // raw memory image, like the data section the assembler keeps
+    void load_image(const uint8_t* bytes, size_t size);
     const uint8_t* data_raw() { return data.data(); }
 };
\ No newline at end of file
@@ -0,0 +1,287 @@
+#include "EmulatorServer.h"
+#include "Bytes.h"
+#include <File.hpp>
+#include <Printer.hpp>
+
+static void build_reply(Vector<uint8_t>& reply, const EmulateReply& header, const String& output,
+                        const uint8_t* memory) {
+    reply.clear();
+    reply.reserve(sizeof(header) + output.size() + static_cast<size_t>(header.memory_size));
+    append_bytes(reply, &header, sizeof(header));
+    append_bytes(reply, output.data(), output.size());
+    append_bytes(reply, memory, static_cast<size_t>(header.memory_size));
+}
+
+static void failure_reply(Vector<uint8_t>& reply, const String& message) {
+    EmulateReply header{};
+    header.output_size = static_cast<uint32_t>(message.size());
+    build_reply(reply, header, message, nullptr);
+}
+
+static bool read_text(StringView path, String& text, String& error) {
+    auto contents_or_err = File::read_all(Path{String{path}});
+    if (contents_or_err.is_error()) {
+        error = Printer::format("Error opening {}: {}\n", path, contents_or_err.to_error());
+        return false;
+    }
+    text = contents_or_err.to_ok();
+    return true;
+}
+
+static JobStatus job_status(StopReason reason) {
+    switch (reason) {
+    case StopReason::Halted:
+        return JobStatus::Halted;
+    case StopReason::StepLimit:
+        return JobStatus::StepLimit;
+    case StopReason::PcOutOfRange:
+        return JobStatus::PcOutOfRange;
+    case StopReason::BadAddress:
+        return JobStatus::BadAddress;
+    case StopReason::CycleLimit:
+        return JobStatus::CycleLimit;
+    case StopReason::TimeLimit:
+        return JobStatus::TimeLimit;
+    }
+    return JobStatus::Failed;
+}
+// only for jobs that didn't fail
+static StopReason stop_reason(JobStatus status) {
+    switch (status) {
+    case JobStatus::StepLimit:
+        return StopReason::StepLimit;
+    case JobStatus::PcOutOfRange:
+        return StopReason::PcOutOfRange;
+    case JobStatus::BadAddress:
+        return StopReason::BadAddress;
+    case JobStatus::CycleLimit:
+        return StopReason::CycleLimit;
+    case JobStatus::TimeLimit:
+        return StopReason::TimeLimit;
+    default:
+        return StopReason::Halted;
+    }
+}
+
+void EmulatorServer::serve() {
+    auto handler = [this](const Vector<uint8_t>& request, Vector<uint8_t>& reply) { handle(request, reply); };
+    m_server.serve(handler);
+}
+
+// with m_lock held
+EmulatorServer::CachedProgram* EmulatorServer::find_program(uint64_t hash, const Vector<uint8_t>& key) {
+    for (auto& entry : m_cache) {
+        if (entry.hash != hash || entry.key.size() != key.size()) continue;
+        if (key.size() > 0 && ARLib::memcmp(entry.key.data(), key.data(), key.size()) != 0) continue;
+        return &entry;
+    }
+    return nullptr;
+}
+
+// Loads the cached program into cpu and returns its id, 0 if it isn't cached
+uint64_t EmulatorServer::checkout(uint64_t hash, const Vector<uint8_t>& key, CPU& cpu, uint32_t& cached_programs) {
+    LockGuard guard{m_lock};
+    cached_programs = static_cast<uint32_t>(m_cache.size());
+    CachedProgram* entry = find_program(hash, key);
+    if (entry == nullptr) return 0;
+    ++entry->users;
+    // the instructions live on the heap, they stay put even if m_cache grows and moves the entry
+    cpu.load(entry->code.instructions.data(), entry->code.instructions.size(), entry->data);
+    return entry->id;
+}
+
+// Takes over the freshly loaded program and loads it into cpu. The oldest programs nobody is running make room for
+// it. Returns 0 and leaves everything alone when it can't be kept, the caller runs its own copy then.
+uint64_t EmulatorServer::add_program(uint64_t hash, Vector<uint8_t>& key, InstructionData& code, BinaryData& data,
+                                     CPU& cpu, uint32_t& cached_programs) {
+    const size_t size = key.size() + code.instructions.size() * sizeof(DecodedInstruction) + data.data.size();
+    if (size > max_cache_bytes) return 0;
+    LockGuard guard{m_lock};
+    // another job may have loaded the same program in the meantime
+    if (CachedProgram* entry = find_program(hash, key); entry != nullptr) {
+        ++entry->users;
+        cached_programs = static_cast<uint32_t>(m_cache.size());
+        cpu.load(entry->code.instructions.data(), entry->code.instructions.size(), entry->data);
+        return entry->id;
+    }
+    Vector<CachedProgram> kept{};
+    kept.reserve(m_cache.size() + 1);
+    for (auto& entry : m_cache) {
+        if (entry.users == 0 && m_cache_bytes + size > max_cache_bytes) {
+            m_cache_bytes -= entry.bytes;
+            continue;
+        }
+        kept.append(move(entry));
+    }
+    m_cache = move(kept);
+    if (m_cache_bytes + size > max_cache_bytes) {
+        cached_programs = static_cast<uint32_t>(m_cache.size());
+        return 0;
+    }
+    const uint64_t id = m_next_id++;
+    m_cache.append(CachedProgram{hash, id, move(key), move(code), move(data), 1, size});
+    m_cache_bytes += size;
+    cached_programs = static_cast<uint32_t>(m_cache.size());
+    const auto& entry = m_cache[m_cache.size() - 1];
+    cpu.load(entry.code.instructions.data(), entry.code.instructions.size(), entry.data);
+    return id;
+}
+
+void EmulatorServer::release(uint64_t id) {
+    LockGuard guard{m_lock};
+    for (auto& entry : m_cache) {
+        if (entry.id != id) continue;
+        --entry.users;
+        return;
+    }
+}
+
+void EmulatorServer::handle(const Vector<uint8_t>& request, Vector<uint8_t>& reply) {
+    EmulateRequest header{};
+    if (request.size() < sizeof(header)) {
+        failure_reply(reply, "malformed request\n"_s);
+        return;
+    }
+    ARLib::memcpy(&header, request.data(), sizeof(header));
+    const size_t payload = static_cast<size_t>(header.code_size) + header.data_size;
+    if (header.magic != EmulateRequest::magic_value || request.size() - sizeof(header) != payload) {
+        failure_reply(reply, "malformed request\n"_s);
+        return;
+    }
+    if (header.flags & EmulateRequest::stop_server) {
+        EmulateReply stopped{};
+        stopped.status = JobStatus::Halted;
+        build_reply(reply, stopped, String{}, nullptr);
+        m_server.stop();
+        return;
+    }
+    const char* payload_data = reinterpret_cast<const char*>(request.data() + sizeof(header));
+    StringView code_text{payload_data, payload_data + header.code_size};
+    StringView data_text{payload_data + header.code_size, payload_data + payload};
+    String code_file{};
+    String data_file{};
+    if (header.flags & EmulateRequest::sources_are_paths) {
+        String error{};
+        if (!read_text(code_text, code_file, error) || !read_text(data_text, data_file, error)) {
+            failure_reply(reply, error);
+            return;
+        }
+        code_text = code_file.view();
+        data_text = data_file.view();
+    }
+
+    // the key is the program itself, the code size keeps apart code and data that only split differently
+    const uint32_t code_size = static_cast<uint32_t>(code_text.size());
+    Vector<uint8_t> key{};
+    key.reserve(sizeof(code_size) + code_text.size() + data_text.size());
+    append_bytes(key, &code_size, sizeof(code_size));
+    append_bytes(key, code_text.data(), code_text.size());
+    append_bytes(key, data_text.data(), data_text.size());
+    const uint64_t hash = content_hash(key);
+
+    EmulateReply result{};
+    CPU cpu{};
+    InstructionData code{};
+    BinaryData data{};
+    uint64_t id = checkout(hash, key, cpu, result.cached_programs);
+    result.cached = id != 0;
+    if (id == 0) {
+        if (auto res = code.load_text(String{code_text}); res.is_error()) {
+            failure_reply(reply, Printer::format("Error loading the code: {}\n", res.to_error()));
+            return;
+        }
+        if (auto res = data.load_text(String{data_text}); res.is_error()) {
+            failure_reply(reply, Printer::format("Error loading the rodata: {}\n", res.to_error()));
+            return;
+        }
+        id = add_program(hash, key, code, data, cpu, result.cached_programs);
+        if (id == 0) cpu.load(code.instructions.data(), code.instructions.size(), data);
+    }
+
+    RunLimits limits{};
+    limits.max_steps = header.max_steps == 0 ? default_max_steps : header.max_steps;
+    if (header.max_cycles != 0) limits.max_cycles = header.max_cycles;
+    limits.time_limit_ms = header.time_limit_ms;
+    // a bad address in a client's program stops its job instead of taking the server down
+    const StopReason reason = cpu.run_for<CheckedPolicy>(limits);
+    if (id != 0) release(id);
+    result.status = job_status(reason);
+    result.fp_flag = cpu.fpflag();
+    result.steps = cpu.clock_count();
+    result.pc = cpu.pc();
+    const auto& memory = cpu.memory();
+    result.memory_digest = cpu.memory_digest();
+    if (header.flags & EmulateRequest::want_memory) result.memory_size = memory.size();
+    for (size_t i = 0; i < 32; ++i) {
+        result.regs[i] = cpu.reg(i);
+        result.fregs[i] = cpu.freg(i);
+    }
+    build_reply(reply, result, String{}, memory.data());
+}
+
+static void print_result(const EmulateReply& result) {
+    const StopReason reason = stop_reason(result.status);
+    CPUState state{result.pc, result.steps, {}, {}, result.fp_flag != 0, reason == StopReason::Halted};
+    for (size_t i = 0; i < 32; ++i) {
+        state.regs[i] = result.regs[i];
+        state.fregs[i] = result.fregs[i];
+    }
+    CPU::print_result(reason, state, result.memory_digest);
+    Printer::print("Decoded program {}, {} programs cached", result.cached ? "was cached"_sv : "was loaded"_sv,
+                   result.cached_programs);
+}
+
+int emulate_remotely(StringView socket_path, const String& code_file, const String& rodata_file,
+                     const EmulatorClientOptions& options) {
+    EmulateRequest header{};
+    header.flags = EmulateRequest::want_memory;
+    header.max_steps = options.max_steps;
+    header.max_cycles = options.max_cycles;
+    header.time_limit_ms = options.time_limit_ms;
+    String code{};
+    String data{};
+    if (options.send_paths) {
+        header.flags |= EmulateRequest::sources_are_paths;
+        code = code_file;
+        data = rodata_file;
+    } else {
+        String error{};
+        if (!read_text(code_file.view(), code, error) || !read_text(rodata_file.view(), data, error)) {
+            print_server_output(error.view());
+            return error_exit_status;
+        }
+    }
+    if (code.size() + data.size() > LocalSocket::max_message_size) {
+        Printer::print("Error opening the program: it's too big to be sent to the server");
+        return error_exit_status;
+    }
+    header.code_size = static_cast<uint32_t>(code.size());
+    header.data_size = static_cast<uint32_t>(data.size());
+    Vector<uint8_t> request{};
+    append_bytes(request, &header, sizeof(header));
+    append_bytes(request, code.data(), code.size());
+    append_bytes(request, data.data(), data.size());
+
+    Vector<uint8_t> reply{};
+    EmulateReply result{};
+    if (!round_trip(socket_path, request, reply, result)) return error_exit_status;
+    const uint8_t* payload = reply.data() + sizeof(result);
+    print_server_output(StringView{reinterpret_cast<const char*>(payload), result.output_size});
+    if (result.status == JobStatus::Failed) return error_exit_status;
+    payload += result.output_size;
+    Vector<uint8_t> memory{};
+    append_bytes(memory, payload, static_cast<size_t>(result.memory_size));
+    CPU::dump_memory(memory);
+    print_result(result);
+    return exit_status(stop_reason(result.status));
+}
+
+bool stop_emulator_server(StringView socket_path) {
+    EmulateRequest header{};
+    header.flags = EmulateRequest::stop_server;
+    Vector<uint8_t> request{};
+    append_bytes(request, &header, sizeof(header));
+    Vector<uint8_t> reply{};
+    EmulateReply result{};
+    return round_trip(socket_path, request, reply, result) && result.status != JobStatus::Failed;
+}
\ No newline at end of file
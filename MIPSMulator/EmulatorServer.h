@@ -0,0 +1,99 @@
+#pragma once
+#include "CPU.h"
+#include "LocalServer.h"
+#include <String.hpp>
+#include <StringView.hpp>
+#include <Vector.hpp>
+
+using namespace ARLib;
+
+// Jobs and results exchanged with the emulator server, each one is a single LocalSocket message. Request: the
+// header, then code_size bytes of code file and data_size bytes of rodata file (or their paths). Reply: the header,
+// then output_size bytes of error message and memory_size bytes of final memory.
+struct EmulateRequest {
+    constexpr static uint32_t magic_value = 0x524D454D; // "MEMR"
+    // the server reads the code and the rodata from the paths itself, relative to its own working directory
+    constexpr static uint32_t sources_are_paths = 1u << 0;
+    constexpr static uint32_t want_memory = 1u << 1;
+    constexpr static uint32_t stop_server = 1u << 2;
+    uint32_t magic = magic_value;
+    uint32_t flags = 0;
+    uint32_t code_size = 0;
+    uint32_t data_size = 0;
+    // 0 means the server's default
+    uint64_t max_steps = 0;
+    // 0 means no limit
+    uint64_t max_cycles = 0;
+    uint64_t time_limit_ms = 0;
+};
+
+enum class JobStatus : uint32_t { Halted, StepLimit, PcOutOfRange, Failed, BadAddress, CycleLimit, TimeLimit };
+
+struct EmulateReply {
+    constexpr static uint32_t magic_value = 0x414D454D; // "MEMA"
+    uint32_t magic = magic_value;
+    JobStatus status = JobStatus::Failed;
+    // the decoded program came from the cache
+    uint32_t cached = 0;
+    uint32_t fp_flag = 0;
+    uint32_t output_size = 0;
+    // programs in the server's cache once the job is done
+    uint32_t cached_programs = 0;
+    uint64_t steps = 0;
+    uint64_t pc = 0;
+    // content_hash() of the final memory
+    uint64_t memory_digest = 0;
+    uint64_t memory_size = 0;
+    uint64_t regs[32]{};
+    double fregs[32]{};
+    uint64_t payload_size() const { return output_size + memory_size; }
+};
+
+// Long-running emulator that runs the jobs sent by local clients through a LocalServer. Loaded and predecoded
+// programs are cached keyed by the content of their code and rodata, so running the same program again only copies
+// its initial memory.
+class EmulatorServer {
+    struct CachedProgram {
+        uint64_t hash;
+        uint64_t id;
+        Vector<uint8_t> key;
+        InstructionData code;
+        BinaryData data;
+        // jobs running the program, it can't be evicted until they're done
+        size_t users;
+        size_t bytes;
+    };
+    constexpr static size_t max_cache_bytes = 256 * 1024 * 1024;
+    constexpr static uint64_t default_max_steps = 100'000'000;
+    LocalServer m_server;
+    Mutex m_lock{};
+    // guarded by m_lock, oldest entries first
+    Vector<CachedProgram> m_cache{};
+    size_t m_cache_bytes = 0;
+    uint64_t m_next_id = 1;
+    void handle(const Vector<uint8_t>& request, Vector<uint8_t>& reply);
+    CachedProgram* find_program(uint64_t hash, const Vector<uint8_t>& key);
+    uint64_t checkout(uint64_t hash, const Vector<uint8_t>& key, CPU& cpu, uint32_t& cached_programs);
+    uint64_t add_program(uint64_t hash, Vector<uint8_t>& key, InstructionData& code, BinaryData& data, CPU& cpu,
+                         uint32_t& cached_programs);
+    void release(uint64_t id);
+
+    public:
+    explicit EmulatorServer(const ThreadPool& pool) : m_server(pool) {}
+    DiscardResult<FileError> listen(StringView socket_path) { return m_server.listen(socket_path); }
+    // serves clients until one of them asks the server to stop
+    void serve();
+};
+
+struct EmulatorClientOptions {
+    bool send_paths = false;
+    uint64_t max_steps = 0;
+    uint64_t max_cycles = 0;
+    uint64_t time_limit_ms = 0;
+};
+
+// Has the server run the program and prints its final state, the memory is written to memdump.dat like a local run
+// would. Returns the exit_status() of the run, 1 if the job failed.
+int emulate_remotely(StringView socket_path, const String& code_file, const String& rodata_file,
+                      const EmulatorClientOptions& options);
+bool stop_emulator_server(StringView socket_path);
\ No newline at end of file
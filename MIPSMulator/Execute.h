@@ -0,0 +1,352 @@
+#pragma once
+#include "CPU.h"
+#include <Printer.hpp>
+
+using namespace ARLib;
+
+// The instruction handlers, a template on the RunPolicy so every run_for() instantiation gets its own copy with
+// the policy's checks compiled in or out. Included by CPU.h once CPU is complete.
+
+inline Tuple<int32_t, int32_t, int32_t> extract_fp_regs_from_instruction(uint32_t opcode) {
+    int32_t rs = (opcode >> 11) & 0x1F;
+    int32_t rt = (opcode >> 16) & 0x1F;
+    int32_t rd = (opcode >> 6) & 0x1F;
+    return Tuple{rs, rt, rd};
+}
+inline Tuple<int32_t, int32_t, int16_t> extract_i_instruction(uint32_t opcode) {
+    int32_t rs = (opcode >> 21) & 0x1F;
+    int32_t rt = (opcode >> 16) & 0x1F;
+    int16_t w = static_cast<int16_t>(opcode & 0xffff);
+    return Tuple{rs, rt, w};
+}
+inline Tuple<int32_t, int32_t, int32_t> extract_r_instruction(uint32_t opcode) {
+    int32_t rs = (opcode >> 21) & 0x1F;
+    int32_t rt = (opcode >> 16) & 0x1F;
+    int32_t rd = (opcode >> 11) & 0x1F;
+    return Tuple{rs, rt, rd};
+}
+inline int32_t extract_j_instruction(uint32_t opcode, const CPU& cpu) {
+    int32_t w = opcode & 0x3ffffff;
+    w *= 4;
+    return w;
+}
+inline Pair<int32_t, int32_t> extract_m_instruction(uint32_t opcode) {
+    int32_t rt = (opcode >> 16) & 0x1F;
+    int32_t rd = (opcode >> 11) & 0x1F;
+    return Pair{rt, rd};
+}
+inline int16_t extract_b_instruction(uint32_t opcode, const CPU& cpu) {
+    int16_t w = static_cast<int16_t>(opcode & 0xffff);
+    w *= 4;
+    return w;
+}
+template <typename Policy>
+void DecodedInstruction::execute(CPU& cpu) const {
+    // the handlers below move the pc, the trace disassembles at the address the instruction was at
+    [[maybe_unused]] const uint64_t pc = cpu.pc();
+    switch (static_cast<Instruction>(id)) {
+    case Instruction::LoadByte: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        ARLib::int8_t val = cpu.read<1, Policy::checked_memory>(cpu.reg(rs) + static_cast<uint64_t>(w));
+        cpu.reg(rt, static_cast<uint64_t>(val));
+    } break;
+    case Instruction::LoadByteUnsigned: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        cpu.reg(rt, cpu.read<1, Policy::checked_memory>(cpu.reg(rs) + static_cast<uint64_t>(w)));
+    } break;
+    case Instruction::StoreByte: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        cpu.write<1, Policy::checked_memory>(cpu.reg(rs) + static_cast<uint64_t>(w), cpu.reg(rt));
+    } break;
+    case Instruction::LoadHalfWord: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        ARLib::int16_t val = cpu.read<2, Policy::checked_memory>(cpu.reg(rs) + static_cast<uint64_t>(w));
+        cpu.reg(rt, static_cast<uint64_t>(val));
+    } break;
+    case Instruction::LoadHalfWordUnsigned: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        cpu.reg(rt, cpu.read<2, Policy::checked_memory>(cpu.reg(rs) + static_cast<uint64_t>(w)));
+    } break;
+    case Instruction::StoreHalfWord: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        cpu.write<2, Policy::checked_memory>(cpu.reg(rs) + static_cast<uint64_t>(w), cpu.reg(rt));
+    } break;
+    case Instruction::LoadWord: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        ARLib::int32_t val = cpu.read<4, Policy::checked_memory>(cpu.reg(rs) + static_cast<uint64_t>(w));
+        cpu.reg(rt, static_cast<uint64_t>(val));
+    } break;
+    case Instruction::LoadWordUnsigned: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        cpu.reg(rt, cpu.read<4, Policy::checked_memory>(cpu.reg(rs) + static_cast<uint64_t>(w)));
+    } break;
+    case Instruction::StoreWord: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        cpu.write<4, Policy::checked_memory>(cpu.reg(rs) + static_cast<uint64_t>(w), cpu.reg(rt));
+    } break;
+    case Instruction::LoadDoubleWord: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        ARLib::int64_t val = cpu.read<8, Policy::checked_memory>(cpu.reg(rs) + static_cast<uint64_t>(w));
+        cpu.reg(rt, static_cast<uint64_t>(val));
+    } break;
+    case Instruction::StoreDoubleWord: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        cpu.write<8, Policy::checked_memory>(cpu.reg(rs) + static_cast<uint64_t>(w), cpu.reg(rt));
+    } break;
+    case Instruction::LoadReal: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        cpu.freg(rt, cpu.readf<8, Policy::checked_memory>(cpu.reg(rs) + static_cast<uint64_t>(w)));
+    } break;
+    case Instruction::StoreReal: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        cpu.writef<8, Policy::checked_memory>(cpu.reg(rs) + static_cast<uint64_t>(w), cpu.freg(rt));
+    } break;
+    case Instruction::Halt: {
+        cpu.halt();
+    } break;
+    case Instruction::AddImmediate: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        cpu.reg(rt, cpu.reg(rs) + static_cast<uint64_t>(w));
+    } break;
+    case Instruction::AddImmediateUnsigned: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        cpu.reg(rt, cpu.reg(rs) + static_cast<uint64_t>(w));
+    } break;
+    case Instruction::LogicalAndImmediate: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        cpu.reg(rt, cpu.reg(rs) & static_cast<uint64_t>(w));
+    } break;
+    case Instruction::LogicalOrImmediate: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        cpu.reg(rt, cpu.reg(rs) | static_cast<uint64_t>(w));
+    } break;
+    case Instruction::LogicalXorImmediate: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        cpu.reg(rt, cpu.reg(rs) ^ static_cast<uint64_t>(w));
+    } break;
+    case Instruction::LoadUpperImmediate: {
+        auto [_, rt, w] = extract_i_instruction(opcode);
+        cpu.reg(rt, cpu.reg(rt) | (static_cast<uint64_t>(w) << 32));
+    } break;
+    case Instruction::SetLessThanImmediate: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        cpu.reg(rt, static_cast<int64_t>(cpu.reg(rs)) < static_cast<int64_t>(w));
+    } break;
+    case Instruction::SetLessThanImmediateUnsigned: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        cpu.reg(rt, cpu.reg(rs) < static_cast<uint64_t>(w));
+    } break;
+    case Instruction::BranchIfEqual: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        if (cpu.reg(rs) == cpu.reg(rt)) cpu.move_pc(w);
+    } break;
+    case Instruction::BranchIfNotEqual: {
+        auto [rs, rt, w] = extract_i_instruction(opcode);
+        if (cpu.reg(rs) != cpu.reg(rt)) cpu.move_pc(w);
+    } break;
+    case Instruction::BranchIfZero: {
+        auto [_, rt, w] = extract_i_instruction(opcode);
+        w *= 4;
+        if (cpu.reg(rt) == 0) cpu.move_pc(w);
+    } break;
+    case Instruction::BranchIfNotZero: {
+        auto [_, rt, w] = extract_i_instruction(opcode);
+        w *= 4;
+        if (cpu.reg(rt) != 0) cpu.move_pc(w);
+    } break;
+    case Instruction::Jump: {
+        auto w = extract_j_instruction(opcode, cpu);
+        cpu.move_pc(w);
+    } break;
+    case Instruction::JumpToReg: {
+        auto [_, rt, __] = extract_r_instruction(opcode);
+        cpu.set_pc(cpu.reg(rt) - 4);
+    } break;
+    case Instruction::JumpAndLink: {
+        constexpr auto ra_reg = 31;
+        auto w = extract_j_instruction(opcode, cpu);
+        cpu.reg(ra_reg, cpu.pc() + 4);
+        cpu.move_pc(w);
+    } break;
+    case Instruction::JumpAndLinkToReg: {
+        constexpr auto ra_reg = 31;
+        auto [_, rt, __] = extract_r_instruction(opcode);
+        cpu.reg(ra_reg, cpu.pc() + 4);
+        cpu.set_pc(cpu.reg(rt) - 4);
+    } break;
+    case Instruction::ShiftLefLogical: {
+        auto [rs, _, rd] = extract_r_instruction(opcode);
+        auto shamt = (opcode >> 6) & 0b11111;
+        cpu.reg(rd, cpu.reg(rs) << shamt);
+    } break;
+    case Instruction::ShiftRightLogical: {
+        auto [rs, _, rd] = extract_r_instruction(opcode);
+        auto shamt = (opcode >> 6) & 0b11111;
+        cpu.reg(rd, cpu.reg(rs) >> shamt);
+    } break;
+    case Instruction::ShiftRightArithmetic: {
+        auto [rs, _, rd] = extract_r_instruction(opcode);
+        auto shamt = (opcode >> 6) & 0b11111;
+        auto sign = (cpu.reg(rs) & (1ull << 63));
+        cpu.reg(rd, (cpu.reg(rs) >> shamt) | sign);
+    } break;
+    case Instruction::ShiftLeftByVar: {
+        auto [rs, rt, rd] = extract_r_instruction(opcode);
+        auto shamt = cpu.reg(rt);
+        cpu.reg(rd, cpu.reg(rs) << shamt);
+    } break;
+    case Instruction::ShiftRightByVar: {
+        auto [rs, rt, rd] = extract_r_instruction(opcode);
+        auto shamt = cpu.reg(rt);
+        cpu.reg(rd, cpu.reg(rs) >> shamt);
+    } break;
+    case Instruction::ShiftRightArithByVar: {
+        auto [rs, rt, rd] = extract_r_instruction(opcode);
+        auto shamt = cpu.reg(rt);
+        auto sign = cpu.reg(rs) & (1ull << 63);
+        cpu.reg(rd, (cpu.reg(rs) >> shamt) | sign);
+    } break;
+    case Instruction::MoveIfZero: {
+        auto [rs, rt, rd] = extract_r_instruction(opcode);
+        if (cpu.reg(rt) == 0) cpu.reg(rd, cpu.reg(rs));
+    } break;
+    case Instruction::MoveIfNotZero: {
+        auto [rs, rt, rd] = extract_r_instruction(opcode);
+        if (cpu.reg(rt) != 0) cpu.reg(rd, cpu.reg(rs));
+    } break;
+    case Instruction::Nop:
+        break;
+    case Instruction::LogicalAnd: {
+        auto [rs, rt, rd] = extract_r_instruction(opcode);
+        cpu.reg(rd, cpu.reg(rs) & cpu.reg(rt));
+    } break;
+    case Instruction::LogicalOr: {
+        auto [rs, rt, rd] = extract_r_instruction(opcode);
+        cpu.reg(rd, cpu.reg(rs) | cpu.reg(rt));
+    } break;
+    case Instruction::LogicalXor: {
+        auto [rs, rt, rd] = extract_r_instruction(opcode);
+        cpu.reg(rd, cpu.reg(rs) ^ cpu.reg(rt));
+    } break;
+    case Instruction::SetLessThan: {
+        auto [rs, rt, rd] = extract_r_instruction(opcode);
+        cpu.reg(rd, cpu.reg(rs) < cpu.reg(rt));
+    } break;
+    case Instruction::SetLessThanUnsigned: {
+        auto [rs, rt, rd] = extract_r_instruction(opcode);
+        cpu.reg(rd, cpu.reg(rs) < cpu.reg(rt));
+    } break;
+    case Instruction::Add: {
+        auto [rs, rt, rd] = extract_r_instruction(opcode);
+        cpu.reg(rd, static_cast<int64_t>(cpu.reg(rs)) + static_cast<int64_t>(cpu.reg(rt)));
+    } break;
+    case Instruction::AddUnsigned: {
+        auto [rs, rt, rd] = extract_r_instruction(opcode);
+        cpu.reg(rd, cpu.reg(rs) + cpu.reg(rt));
+    } break;
+    case Instruction::Subtract: {
+        auto [rs, rt, rd] = extract_r_instruction(opcode);
+        cpu.reg(rd, static_cast<int64_t>(cpu.reg(rs)) - static_cast<int64_t>(cpu.reg(rt)));
+    } break;
+    case Instruction::SubtractUnsigned: {
+        auto [rs, rt, rd] = extract_r_instruction(opcode);
+        cpu.reg(rd, cpu.reg(rs) - cpu.reg(rt));
+    } break;
+    case Instruction::Multiply: {
+        auto [rs, rt, rd] = extract_r_instruction(opcode);
+        int64_t mul = static_cast<int64_t>(cpu.reg(rs)) * static_cast<int64_t>(cpu.reg(rt));
+        cpu.reg(rd, static_cast<uint64_t>(mul));
+    } break;
+    case Instruction::MultiplyUnsigned: {
+        auto [rs, rt, rd] = extract_r_instruction(opcode);
+        cpu.reg(rd, cpu.reg(rs) * cpu.reg(rt));
+    } break;
+    case Instruction::Divide: {
+        auto [rs, rt, rd] = extract_r_instruction(opcode);
+        if (cpu.reg(rt) == 0)
+            cpu.reg(rd, 0); // divide by 0
+        else {
+            int64_t div = static_cast<int64_t>(cpu.reg(rs)) / static_cast<int64_t>(cpu.reg(rt));
+            cpu.reg(rd, static_cast<uint64_t>(div));
+        }
+    } break;
+    case Instruction::DivideUnsigned: {
+        auto [rs, rt, rd] = extract_r_instruction(opcode);
+        if (cpu.reg(rt) == 0)
+            cpu.reg(rd, 0); // divide by 0
+        else
+            cpu.reg(rd, cpu.reg(rs) / cpu.reg(rt));
+    } break;
+    case Instruction::AddReal: {
+        auto [rs, rt, rd] = extract_fp_regs_from_instruction(opcode);
+        cpu.freg(rd, cpu.freg(rs) + cpu.freg(rt));
+    } break;
+    case Instruction::SubtractReal: {
+        auto [rs, rt, rd] = extract_fp_regs_from_instruction(opcode);
+        cpu.freg(rd, cpu.freg(rs) - cpu.freg(rt));
+    } break;
+    case Instruction::MultiplyReal: {
+        auto [rs, rt, rd] = extract_fp_regs_from_instruction(opcode);
+        cpu.freg(rd, cpu.freg(rs) * cpu.freg(rt));
+    } break;
+    case Instruction::DivideReal: {
+        auto [rs, rt, rd] = extract_fp_regs_from_instruction(opcode);
+        cpu.freg(rd, cpu.freg(rs) / cpu.freg(rt));
+    } break;
+    case Instruction::MoveReal: {
+        auto [rs, _, rd] = extract_fp_regs_from_instruction(opcode);
+        cpu.freg(rd, cpu.freg(rs));
+    } break;
+    case Instruction::ConvertIntegerToReal: {
+        auto [rs, _, rd] = extract_fp_regs_from_instruction(opcode);
+        // convert 64-bit integer to a double FP format
+        double orig = cpu.freg(rs);
+        uint64_t val = BitCast<uint64_t>(orig);
+        cpu.freg(rd, static_cast<double>(val));
+    } break;
+    case Instruction::ConvertRealToInteger: {
+        auto [rs, _, rd] = extract_fp_regs_from_instruction(opcode);
+        // convert double FP to a 64-bit integer format
+        uint64_t orig = static_cast<uint64_t>(cpu.freg(rs));
+        double val = BitCast<double>(orig);
+        cpu.freg(rd, val);
+    } break;
+    case Instruction::SetFpFlagIfLessThan: {
+        auto [rs, rt, _] = extract_fp_regs_from_instruction(opcode);
+        cpu.fpflag(cpu.freg(rs) < cpu.freg(rt));
+    } break;
+    case Instruction::SetFpFlagIfLessThanOrEqual: {
+        auto [rs, rt, _] = extract_fp_regs_from_instruction(opcode);
+        cpu.fpflag(cpu.freg(rs) <= cpu.freg(rt));
+    } break;
+    case Instruction::SetFpFlagIfEqual: {
+        auto [rs, rt, _] = extract_fp_regs_from_instruction(opcode);
+        cpu.fpflag(cpu.freg(rs) == cpu.freg(rt));
+    } break;
+    case Instruction::BranchIfFpFlagNotSet: {
+        int16_t w = extract_b_instruction(opcode, cpu);
+        if (!cpu.fpflag()) cpu.move_pc(w);
+    } break;
+    case Instruction::BranchIfFpFlagSet: {
+        int16_t w = extract_b_instruction(opcode, cpu);
+        if (cpu.fpflag()) cpu.move_pc(w);
+    } break;
+    case Instruction::MoveDataFromIntegerToFp: {
+        // move data from integer register to FP register
+        auto [rt, rd] = extract_m_instruction(opcode);
+        cpu.freg(rd, static_cast<double>(cpu.reg(rt)));
+    } break;
+    case Instruction::MoveDataFromFpToInteger: {
+        // move data from FP register to integer register
+        auto [rt, rd] = extract_m_instruction(opcode);
+        cpu.reg(rt, static_cast<uint64_t>(cpu.freg(rd)));
+    } break;
+    default:
+        // not an encoding of any instruction
+        break;
+    }
+    if constexpr (Policy::trace) {
+        char buf[64]{};
+        if (disassemble(opcode, pc, buf, sizeof(buf)) > 0) Printer::print("{}", StringView{buf});
+    }
+}
\ No newline at end of file
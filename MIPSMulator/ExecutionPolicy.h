@@ -0,0 +1,93 @@
+#pragma once
+#include "Isa.h"
+#include <Array.hpp>
+#include <Types.hpp>
+
+using namespace ARLib;
+
+// How a run is carried out, fixed at compile time so that a run pays only for what it asked for. CPU::run_for() and
+// the instruction handlers are instantiated once per policy and with_run_policy() picks the instantiation from the
+// options given at startup, the default FastPolicy has no tracing, no bounds checks and no counters at all.
+
+// Every instruction takes one cycle, the clock count is the number of instructions executed
+struct UnitTiming {
+    constexpr static uint64_t cycles(uint8_t) { return 1; }
+};
+
+// Multi-cycle integer multiplies and divides, and the latencies of WinMIPS64's floating point adder (4), multiplier
+// (7) and divider (24). Everything else takes one cycle, stalls between dependent instructions aren't modeled.
+constexpr auto construct_latency_cycles() {
+    Array<uint8_t, isa_table.size()> cycles{};
+    for (auto& c : cycles) c = 1;
+    cycles[ToUnderlying(Instruction::Multiply)] = 5;
+    cycles[ToUnderlying(Instruction::MultiplyUnsigned)] = 5;
+    cycles[ToUnderlying(Instruction::Divide)] = 20;
+    cycles[ToUnderlying(Instruction::DivideUnsigned)] = 20;
+    cycles[ToUnderlying(Instruction::AddReal)] = 4;
+    cycles[ToUnderlying(Instruction::SubtractReal)] = 4;
+    cycles[ToUnderlying(Instruction::MultiplyReal)] = 7;
+    cycles[ToUnderlying(Instruction::DivideReal)] = 24;
+    return cycles;
+}
+struct LatencyTiming {
+    constexpr static auto table = construct_latency_cycles();
+    constexpr static uint64_t cycles(uint8_t id) { return id < table.size() ? table[id] : 1; }
+};
+
+template <bool Trace, bool CheckedMemory, bool Stats, typename Timing = UnitTiming, bool FastForward = false>
+struct RunPolicy {
+    // print every instruction as it's executed
+    constexpr static bool trace = Trace;
+    // loads and stores outside the memory stop the run instead of being undefined behavior
+    constexpr static bool checked_memory = CheckedMemory;
+    // count how many times every instruction is executed
+    constexpr static bool stats = Stats;
+    using TimingModel = Timing;
+    // skip the iterations of counted loops, accounting for them as if they ran
+    constexpr static bool fast_forward = FastForward;
+};
+
+using FastPolicy = RunPolicy<false, false, false>;
+// what the emulator server runs untrusted programs with
+using CheckedPolicy = RunPolicy<false, true, false>;
+
+// The runtime choices with_run_policy() turns into a RunPolicy
+struct RunOptions {
+    bool trace = false;
+    bool checked_memory = false;
+    bool stats = false;
+    bool latency_timing = false;
+    bool fast_forward = false;
+};
+
+namespace PolicyDispatch {
+    template <bool Trace, bool CheckedMemory, bool Stats, typename Timing, typename Func>
+    decltype(auto) pick_fast_forward(const RunOptions& options, Func&& func) {
+        if (options.fast_forward) return func(RunPolicy<Trace, CheckedMemory, Stats, Timing, true>{});
+        return func(RunPolicy<Trace, CheckedMemory, Stats, Timing, false>{});
+    }
+    template <bool Trace, bool CheckedMemory, bool Stats, typename Func>
+    decltype(auto) pick_timing(const RunOptions& options, Func&& func) {
+        if (options.latency_timing)
+            return pick_fast_forward<Trace, CheckedMemory, Stats, LatencyTiming>(options, func);
+        return pick_fast_forward<Trace, CheckedMemory, Stats, UnitTiming>(options, func);
+    }
+    template <bool Trace, bool CheckedMemory, typename Func>
+    decltype(auto) pick_stats(const RunOptions& options, Func&& func) {
+        if (options.stats) return pick_timing<Trace, CheckedMemory, true>(options, func);
+        return pick_timing<Trace, CheckedMemory, false>(options, func);
+    }
+    template <bool Trace, typename Func>
+    decltype(auto) pick_checked(const RunOptions& options, Func&& func) {
+        if (options.checked_memory) return pick_stats<Trace, true>(options, func);
+        return pick_stats<Trace, false>(options, func);
+    }
+} // namespace PolicyDispatch
+
+// Calls func(Policy{}) with the RunPolicy matching the options, done once before running so the choice costs nothing
+// per instruction
+template <typename Func>
+decltype(auto) with_run_policy(const RunOptions& options, Func&& func) {
+    if (options.trace) return PolicyDispatch::pick_checked<true>(options, func);
+    return PolicyDispatch::pick_checked<false>(options, func);
+}
\ No newline at end of file
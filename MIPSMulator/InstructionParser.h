@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Isa.h"
 #include <CharConv.hpp>
 #include <File.hpp>
 #include <Path.hpp>
@@ -11,20 +12,34 @@ using namespace ARLib;
 
 class CPU;
 
-struct Instruction {
+struct DecodedInstruction {
     uint32_t opcode;
-    void decode(CPU& cpu, bool print_instructions);
+    // row of isa_table execute() dispatches on, looked up once when the program is loaded
+    uint8_t id = invalid_instruction;
+    // instructions from this one to the end of its basic block, this one included. The run loop checks its limits
+    // and the pc once per block and runs the block without looking at them.
+    uint16_t block_length = 1;
+    void predecode();
+    // runs the instruction on the cpu the way the RunPolicy says, defined in Execute.h
+    template <typename Policy>
+    void execute(CPU& cpu) const;
 };
 
 template <>
-struct ARLib::PrintInfo<Instruction> {
-    const Instruction& m_ins;
-    PrintInfo(const Instruction& ins) : m_ins(ins) {}
+struct ARLib::PrintInfo<DecodedInstruction> {
+    const DecodedInstruction& m_ins;
+    PrintInfo(const DecodedInstruction& ins) : m_ins(ins) {}
     String repr() const { return IntToStr(m_ins.opcode); }
 };
 
 struct InstructionData {
-    Vector<Instruction> instructions;
+    Vector<DecodedInstruction> instructions;
     InstructionData() = default;
     DiscardResult<FileError> load(const Path& p);
+    // same as load() on a file with these contents
+    DiscardResult<FileError> load_text(const String& text);
+    // already encoded instructions, like the words of a .cbin file
+    void load_words(const uint32_t* words, size_t count);
+    // sets block_length of every instruction, done by the loads once the whole program is there
+    void find_blocks();
 };
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "NativeProgram.h"
+#include "Translator.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+static void* open_library(const String& path) {
+#ifdef _WIN32
+    return reinterpret_cast<void*>(LoadLibraryA(path.data()));
+#else
+    return dlopen(path.data(), RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+static void close_library(void* library) {
+#ifdef _WIN32
+    FreeLibrary(reinterpret_cast<HMODULE>(library));
+#else
+    dlclose(library);
+#endif
+}
+static void* find_symbol(void* library, const char* name) {
+#ifdef _WIN32
+    return reinterpret_cast<void*>(GetProcAddress(reinterpret_cast<HMODULE>(library), name));
+#else
+    return dlsym(library, name);
+#endif
+}
+
+DiscardResult<FileError> NativeProgram::load(StringView library) {
+    using InfoFunction = uint64_t (*)();
+    unload();
+    m_library = open_library(String{library});
+    if (m_library == nullptr) return FileError{"Failed to load the translated program"_s};
+    auto abi_version = reinterpret_cast<InfoFunction>(find_symbol(m_library, "asq_abi_version"));
+    auto library_hash = reinterpret_cast<InfoFunction>(find_symbol(m_library, "asq_code_hash"));
+    auto library_size = reinterpret_cast<InfoFunction>(find_symbol(m_library, "asq_code_size"));
+    m_run = reinterpret_cast<RunFunction>(find_symbol(m_library, "asq_run"));
+    if (abi_version == nullptr || library_hash == nullptr || library_size == nullptr || m_run == nullptr) {
+        unload();
+        return FileError{"The library isn't a translated program"_s};
+    }
+    if (abi_version() != native_abi_version) {
+        unload();
+        return FileError{"The program was translated by a different version of the emulator"_s};
+    }
+    m_code_hash = library_hash();
+    m_code_size = library_size();
+    return {};
+}
+void NativeProgram::unload() {
+    if (m_library != nullptr) close_library(m_library);
+    m_library = nullptr;
+    m_run = nullptr;
+}
+bool NativeProgram::matches(const CPU& cpu) const {
+    return m_run != nullptr && m_code_size == cpu.m_code_size && m_code_hash == code_hash(cpu.m_code, cpu.m_code_size);
+}
+
+static uint64_t saturating_add(uint64_t a, uint64_t b) {
+    return a + b < a ? ~static_cast<uint64_t>(0) : a + b;
+}
+
+StopReason NativeProgram::run(CPU& cpu, const RunLimits& limits) const {
+    // same interval as CPU::run_for(), a deadline is looked at between blocks once this many steps went by
+    constexpr uint64_t clock_check_interval = 1 << 16;
+    NativeState state{};
+    for (size_t i = 0; i < 32; ++i) {
+        state.regs[i] = cpu.m_regs[i];
+        state.fregs[i] = cpu.m_freg[i];
+    }
+    state.memory = cpu.m_ro_data.data.data();
+    state.dirty = cpu.m_dirty.data();
+    state.pc = cpu.m_pc;
+    state.steps = cpu.m_clock_count;
+    state.fp_flag = cpu.m_fp_flag;
+    state.halted = cpu.m_halted;
+    const uint64_t start_steps = state.steps;
+    const uint64_t deadline = limits.time_limit_ms == 0 ? 0 : monotonic_ns() + limits.time_limit_ms * 1'000'000;
+    const uint64_t step_limit = saturating_add(start_steps, limits.max_steps);
+    // every instruction takes one cycle, so the cycle budget is a number of steps too
+    const uint64_t cycle_limit = saturating_add(start_steps, limits.max_cycles);
+    uint64_t next_clock_check = start_steps + clock_check_interval;
+    StopReason reason = StopReason::Halted;
+    bool finish_interpreted = false;
+    for (;;) {
+        const uint64_t soft_limit = deadline != 0 && next_clock_check < cycle_limit ? next_clock_check : cycle_limit;
+        const auto stop = static_cast<NativeStop>(m_run(&state, step_limit, soft_limit));
+        if (stop == NativeStop::Halted) {
+            reason = StopReason::Halted;
+            break;
+        }
+        if (stop == NativeStop::PcOutOfRange) {
+            reason = StopReason::PcOutOfRange;
+            break;
+        }
+        if (stop == NativeStop::Budget) {
+            finish_interpreted = true;
+            break;
+        }
+        if (state.steps >= cycle_limit) {
+            reason = StopReason::CycleLimit;
+            break;
+        }
+        if (monotonic_ns() >= deadline) {
+            reason = StopReason::TimeLimit;
+            break;
+        }
+        next_clock_check = state.steps + clock_check_interval;
+    }
+    for (size_t i = 0; i < 32; ++i) {
+        cpu.m_regs[i] = state.regs[i];
+        cpu.m_freg[i] = state.fregs[i];
+    }
+    cpu.m_pc = state.pc;
+    cpu.m_fp_flag = state.fp_flag != 0;
+    cpu.m_halted = state.halted != 0;
+    cpu.m_cycles += state.steps - cpu.m_clock_count;
+    cpu.m_clock_count = state.steps;
+    if (!finish_interpreted) return reason;
+    // the block doesn't fit in the steps that are left, only the interpreter can stop in the middle of it
+    RunLimits rest{};
+    rest.max_steps = step_limit - state.steps;
+    return cpu.run_for(rest);
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+#include "CPU.h"
+#include <File.hpp>
+#include <StringView.hpp>
+#include <Types.hpp>
+
+using namespace ARLib;
+
+// Everything translated code sees of the CPU. translate_program() writes the same definition into every file it
+// generates, native_abi_version has to change whenever either one does.
+struct NativeState {
+    uint64_t regs[32];
+    double fregs[32];
+    uint8_t* memory;
+    // the dirty line bitmap of the CPU, translated stores keep it up to date like CPU::write does
+    uint64_t* dirty;
+    uint64_t pc;
+    // instructions executed, the clock count of the CPU
+    uint64_t steps;
+    uint32_t fp_flag;
+    uint32_t halted;
+};
+constexpr uint64_t native_abi_version = 1;
+
+// Why the asq_run() of a translated program returned
+enum class NativeStop : uint32_t {
+    Halted,
+    // the step limit was reached, or the next block has more instructions than the steps left
+    Budget,
+    PcOutOfRange,
+    // the steps reached the soft limit when a block was about to start
+    SoftLimit
+};
+
+// A program translated ahead of time by translate_program() and compiled into a shared object by build_native().
+// It runs whole basic blocks of native code with the guest registers in locals, like a FastPolicy run: no tracing,
+// no bounds checks, no statistics and one cycle per instruction. The results are the same as the interpreter's.
+class NativeProgram {
+    using RunFunction = uint32_t (*)(NativeState*, uint64_t, uint64_t);
+    void* m_library = nullptr;
+    RunFunction m_run = nullptr;
+    uint64_t m_code_hash = 0;
+    uint64_t m_code_size = 0;
+
+    public:
+    NativeProgram() = default;
+    NativeProgram(const NativeProgram&) = delete;
+    NativeProgram& operator=(const NativeProgram&) = delete;
+    ~NativeProgram() { unload(); }
+    DiscardResult<FileError> load(StringView library);
+    void unload();
+    // the library was translated from the program loaded in the cpu
+    bool matches(const CPU& cpu) const;
+    // Runs the program loaded in the cpu within the limits, like CPU::run_for<FastPolicy>(). When fewer steps are
+    // left than the next block has instructions, the interpreter runs the rest of them.
+    StopReason run(CPU& cpu, const RunLimits& limits) const;
+};
\ No newline at end of file
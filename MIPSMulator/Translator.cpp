@@ -0,0 +1,496 @@
+#include "Translator.h"
+#include "OutputFile.h"
+#include <Printer.hpp>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <errno.h>
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+uint64_t code_hash(const DecodedInstruction* code, size_t count) {
+    // FNV-1a over the bytes of the words
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t b = 0; b < sizeof(uint32_t); ++b)
+            hash = (hash ^ ((code[i].opcode >> (b * 8)) & 0xFF)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Everything but the blocks. The helpers are CPU::read, CPU::write and BitCast, stores mark their lines dirty.
+static constexpr StringView prelude = R"(#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define ASQ_EXPORT extern "C" __declspec(dllexport)
+#else
+#define ASQ_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+struct NativeState {
+    uint64_t regs[32];
+    double fregs[32];
+    uint8_t* memory;
+    uint64_t* dirty;
+    uint64_t pc;
+    uint64_t steps;
+    uint32_t fp_flag;
+    uint32_t halted;
+};
+
+static inline void mark_dirty(uint64_t* dirty, uint64_t addr, uint64_t size) {
+    const uint64_t first = addr / DIRTY_LINE_SIZE;
+    const uint64_t last = (addr + size - 1) / DIRTY_LINE_SIZE;
+    dirty[first / 64] |= 1ull << (first % 64);
+    dirty[last / 64] |= 1ull << (last % 64);
+}
+static inline uint8_t load8(const uint8_t* m, uint64_t a) { uint8_t v; memcpy(&v, m + a, 1); return v; }
+static inline uint16_t load16(const uint8_t* m, uint64_t a) { uint16_t v; memcpy(&v, m + a, 2); return v; }
+static inline uint32_t load32(const uint8_t* m, uint64_t a) { uint32_t v; memcpy(&v, m + a, 4); return v; }
+static inline uint64_t load64(const uint8_t* m, uint64_t a) { uint64_t v; memcpy(&v, m + a, 8); return v; }
+static inline double loadf64(const uint8_t* m, uint64_t a) { double v; memcpy(&v, m + a, 8); return v; }
+static inline void store(uint8_t* m, uint64_t* d, uint64_t a, uint64_t v, int size) {
+    mark_dirty(d, a, size);
+    for (int i = 0; i < size; ++i) m[a + i] = (uint8_t)((v >> (8 * i)) & 0xFF);
+}
+static inline uint64_t bits_of(double v) { uint64_t b; memcpy(&b, &v, 8); return b; }
+static inline double real_of(uint64_t b) { double v; memcpy(&v, &b, 8); return v; }
+
+typedef void (*BlockFunction)(NativeState*, uint32_t);
+struct BlockEntry {
+    BlockFunction run;
+    uint32_t offset;
+    uint32_t remaining;
+};
+)";
+
+// One basic block. Every register the block touches is a local, loaded when the block starts and stored back at its
+// end if the block writes it. A block can be entered at any of its instructions, the cases of its switch fall
+// through to the end.
+class BlockWriter {
+    Array<bool, 32> m_regs_used{};
+    Array<bool, 32> m_regs_written{};
+    Array<bool, 32> m_fregs_used{};
+    Array<bool, 32> m_fregs_written{};
+    bool m_fp_used = false;
+    bool m_fp_written = false;
+    bool m_memory_used = false;
+    bool m_stores = false;
+    String m_body{};
+
+    public:
+    String r(int32_t n) {
+        m_regs_used[n] = true;
+        return Printer::format("r{}", n);
+    }
+    String set_r(int32_t n) {
+        m_regs_written[n] = true;
+        return r(n);
+    }
+    String f(int32_t n) {
+        m_fregs_used[n] = true;
+        return Printer::format("f{}", n);
+    }
+    String set_f(int32_t n) {
+        m_fregs_written[n] = true;
+        return f(n);
+    }
+    StringView fp() {
+        m_fp_used = true;
+        return "fp"_sv;
+    }
+    StringView set_fp() {
+        m_fp_written = true;
+        return fp();
+    }
+    StringView memory() {
+        m_memory_used = true;
+        return "mem"_sv;
+    }
+    String store_args(const String& addr) {
+        m_memory_used = true;
+        m_stores = true;
+        return Printer::format("mem, dirty, {}", addr);
+    }
+    void append(const String& code) {
+        m_body += code;
+    }
+    void write(OutputFile& out, size_t index, size_t length) const {
+        out.write(Printer::format("static void block_{}(NativeState* s, uint32_t start) ", index).view());
+        out.write("{\n"_sv);
+        if (m_memory_used) out.write("    uint8_t* const mem = s->memory;\n"_sv);
+        if (m_stores) out.write("    uint64_t* const dirty = s->dirty;\n"_sv);
+        out.write("    uint64_t pc = s->pc;\n"_sv);
+        for (size_t i = 0; i < 32; ++i) {
+            if (m_regs_used[i]) out.write(Printer::format("    uint64_t r{} = s->regs[{}];\n", i, i).view());
+        }
+        for (size_t i = 0; i < 32; ++i) {
+            if (m_fregs_used[i]) out.write(Printer::format("    double f{} = s->fregs[{}];\n", i, i).view());
+        }
+        if (m_fp_used) out.write("    uint32_t fp = s->fp_flag;\n"_sv);
+        out.write("    switch (start) {\n"_sv);
+        out.write(m_body.view());
+        out.write("    }\n"_sv);
+        for (size_t i = 0; i < 32; ++i) {
+            if (m_regs_written[i]) out.write(Printer::format("    s->regs[{}] = r{};\n", i, i).view());
+        }
+        for (size_t i = 0; i < 32; ++i) {
+            if (m_fregs_written[i]) out.write(Printer::format("    s->fregs[{}] = f{};\n", i, i).view());
+        }
+        if (m_fp_written) out.write("    s->fp_flag = fp;\n"_sv);
+        out.write("    s->pc = pc;\n"_sv);
+        out.write(Printer::format("    s->steps += {}u - start;\n", length).view());
+        out.write("}\n"_sv);
+    }
+};
+
+// The statement for one instruction, the same operations on the same types as its handler in Execute.h. The
+// fields and immediates are decoded here, the same way the extract_* helpers decode them.
+static String translate_instruction(BlockWriter& b, const DecodedInstruction& ins) {
+    const uint32_t opcode = ins.opcode;
+    const int32_t i_rs = (opcode >> 21) & 0x1F;
+    const int32_t i_rt = (opcode >> 16) & 0x1F;
+    const int16_t i_w = static_cast<int16_t>(opcode & 0xffff);
+    // static_cast<uint64_t>(w) in the handlers, the immediate sign extended
+    const uint64_t imm = static_cast<uint64_t>(i_w);
+    const int32_t r_rd = (opcode >> 11) & 0x1F;
+    const uint32_t shamt = (opcode >> 6) & 0b11111;
+    const int32_t fs = (opcode >> 11) & 0x1F;
+    const int32_t ft = (opcode >> 16) & 0x1F;
+    const int32_t fd = (opcode >> 6) & 0x1F;
+    const auto address = [&] { return Printer::format("{} + {}ull", b.r(i_rs), imm); };
+    // move_pc() adds a signed offset to the pc, which is the same as adding it as unsigned
+    const auto move_pc = [](int64_t offset) { return Printer::format("pc += {}ull;", static_cast<uint64_t>(offset)); };
+    switch (static_cast<Instruction>(ins.id)) {
+    case Instruction::LoadByte:
+        return Printer::format("{} = (uint64_t)(int8_t)load8({}, {});", b.set_r(i_rt), b.memory(), address());
+    case Instruction::LoadByteUnsigned:
+        return Printer::format("{} = (uint64_t)load8({}, {});", b.set_r(i_rt), b.memory(), address());
+    case Instruction::StoreByte:
+        return Printer::format("store({}, {}, 1);", b.store_args(address()), b.r(i_rt));
+    case Instruction::LoadHalfWord:
+        return Printer::format("{} = (uint64_t)(int16_t)load16({}, {});", b.set_r(i_rt), b.memory(), address());
+    case Instruction::LoadHalfWordUnsigned:
+        return Printer::format("{} = (uint64_t)load16({}, {});", b.set_r(i_rt), b.memory(), address());
+    case Instruction::StoreHalfWord:
+        return Printer::format("store({}, {}, 2);", b.store_args(address()), b.r(i_rt));
+    case Instruction::LoadWord:
+        return Printer::format("{} = (uint64_t)(int32_t)load32({}, {});", b.set_r(i_rt), b.memory(), address());
+    case Instruction::LoadWordUnsigned:
+        return Printer::format("{} = (uint64_t)load32({}, {});", b.set_r(i_rt), b.memory(), address());
+    case Instruction::StoreWord:
+        return Printer::format("store({}, {}, 4);", b.store_args(address()), b.r(i_rt));
+    case Instruction::LoadDoubleWord:
+        return Printer::format("{} = load64({}, {});", b.set_r(i_rt), b.memory(), address());
+    case Instruction::StoreDoubleWord:
+        return Printer::format("store({}, {}, 8);", b.store_args(address()), b.r(i_rt));
+    case Instruction::LoadReal:
+        return Printer::format("{} = loadf64({}, {});", b.set_f(i_rt), b.memory(), address());
+    case Instruction::StoreReal:
+        return Printer::format("store({}, bits_of({}), 8);", b.store_args(address()), b.f(i_rt));
+    case Instruction::Halt:
+        return "s->halted = 1;"_s;
+    case Instruction::AddImmediate:
+    case Instruction::AddImmediateUnsigned:
+        return Printer::format("{} = {} + {}ull;", b.set_r(i_rt), b.r(i_rs), imm);
+    case Instruction::LogicalAndImmediate:
+        return Printer::format("{} = {} & {}ull;", b.set_r(i_rt), b.r(i_rs), imm);
+    case Instruction::LogicalOrImmediate:
+        return Printer::format("{} = {} | {}ull;", b.set_r(i_rt), b.r(i_rs), imm);
+    case Instruction::LogicalXorImmediate:
+        return Printer::format("{} = {} ^ {}ull;", b.set_r(i_rt), b.r(i_rs), imm);
+    case Instruction::LoadUpperImmediate:
+        return Printer::format("{} = {} | {}ull;", b.set_r(i_rt), b.r(i_rt), imm << 32);
+    case Instruction::SetLessThanImmediate:
+        return Printer::format("{} = (int64_t){} < (int64_t){};", b.set_r(i_rt), b.r(i_rs), static_cast<int32_t>(i_w));
+    case Instruction::SetLessThanImmediateUnsigned:
+        return Printer::format("{} = {} < {}ull;", b.set_r(i_rt), b.r(i_rs), imm);
+    case Instruction::BranchIfEqual:
+        return Printer::format("if ({} == {}) {}", b.r(i_rs), b.r(i_rt), move_pc(i_w));
+    case Instruction::BranchIfNotEqual:
+        return Printer::format("if ({} != {}) {}", b.r(i_rs), b.r(i_rt), move_pc(i_w));
+    case Instruction::BranchIfZero: {
+        int16_t w = i_w;
+        w *= 4;
+        return Printer::format("if ({} == 0) {}", b.r(i_rt), move_pc(w));
+    }
+    case Instruction::BranchIfNotZero: {
+        int16_t w = i_w;
+        w *= 4;
+        return Printer::format("if ({} != 0) {}", b.r(i_rt), move_pc(w));
+    }
+    case Instruction::Jump: {
+        int32_t w = opcode & 0x3ffffff;
+        w *= 4;
+        return move_pc(w);
+    }
+    case Instruction::JumpToReg:
+        return Printer::format("pc = {} - 4;", b.r(i_rt));
+    case Instruction::JumpAndLink: {
+        int32_t w = opcode & 0x3ffffff;
+        w *= 4;
+        return Printer::format("{} = pc + 4; {}", b.set_r(31), move_pc(w));
+    }
+    case Instruction::JumpAndLinkToReg:
+        return Printer::format("{} = pc + 4; pc = {} - 4;", b.set_r(31), b.r(i_rt));
+    case Instruction::ShiftLefLogical:
+        return Printer::format("{} = {} << {};", b.set_r(r_rd), b.r(i_rs), shamt);
+    case Instruction::ShiftRightLogical:
+        return Printer::format("{} = {} >> {};", b.set_r(r_rd), b.r(i_rs), shamt);
+    case Instruction::ShiftRightArithmetic:
+        return Printer::format("{} = ({} >> {}) | ({} & (1ull << 63));", b.set_r(r_rd), b.r(i_rs), shamt, b.r(i_rs));
+    case Instruction::ShiftLeftByVar:
+        return Printer::format("{} = {} << {};", b.set_r(r_rd), b.r(i_rs), b.r(i_rt));
+    case Instruction::ShiftRightByVar:
+        return Printer::format("{} = {} >> {};", b.set_r(r_rd), b.r(i_rs), b.r(i_rt));
+    case Instruction::ShiftRightArithByVar:
+        return Printer::format("{} = ({} >> {}) | ({} & (1ull << 63));", b.set_r(r_rd), b.r(i_rs), b.r(i_rt),
+                               b.r(i_rs));
+    case Instruction::MoveIfZero:
+        return Printer::format("if ({} == 0) {} = {};", b.r(i_rt), b.set_r(r_rd), b.r(i_rs));
+    case Instruction::MoveIfNotZero:
+        return Printer::format("if ({} != 0) {} = {};", b.r(i_rt), b.set_r(r_rd), b.r(i_rs));
+    case Instruction::Nop:
+        return String{};
+    case Instruction::LogicalAnd:
+        return Printer::format("{} = {} & {};", b.set_r(r_rd), b.r(i_rs), b.r(i_rt));
+    case Instruction::LogicalOr:
+        return Printer::format("{} = {} | {};", b.set_r(r_rd), b.r(i_rs), b.r(i_rt));
+    case Instruction::LogicalXor:
+        return Printer::format("{} = {} ^ {};", b.set_r(r_rd), b.r(i_rs), b.r(i_rt));
+    case Instruction::SetLessThan:
+    case Instruction::SetLessThanUnsigned:
+        return Printer::format("{} = {} < {};", b.set_r(r_rd), b.r(i_rs), b.r(i_rt));
+    case Instruction::Add:
+        return Printer::format("{} = (uint64_t)((int64_t){} + (int64_t){});", b.set_r(r_rd), b.r(i_rs), b.r(i_rt));
+    case Instruction::AddUnsigned:
+        return Printer::format("{} = {} + {};", b.set_r(r_rd), b.r(i_rs), b.r(i_rt));
+    case Instruction::Subtract:
+        return Printer::format("{} = (uint64_t)((int64_t){} - (int64_t){});", b.set_r(r_rd), b.r(i_rs), b.r(i_rt));
+    case Instruction::SubtractUnsigned:
+        return Printer::format("{} = {} - {};", b.set_r(r_rd), b.r(i_rs), b.r(i_rt));
+    case Instruction::Multiply:
+        return Printer::format("{} = (uint64_t)((int64_t){} * (int64_t){});", b.set_r(r_rd), b.r(i_rs), b.r(i_rt));
+    case Instruction::MultiplyUnsigned:
+        return Printer::format("{} = {} * {};", b.set_r(r_rd), b.r(i_rs), b.r(i_rt));
+    case Instruction::Divide:
+        return Printer::format("{} = {} == 0 ? 0 : (uint64_t)((int64_t){} / (int64_t){});", b.set_r(r_rd), b.r(i_rt),
+                               b.r(i_rs), b.r(i_rt));
+    case Instruction::DivideUnsigned:
+        return Printer::format("{} = {} == 0 ? 0 : {} / {};", b.set_r(r_rd), b.r(i_rt), b.r(i_rs), b.r(i_rt));
+    case Instruction::AddReal:
+        return Printer::format("{} = {} + {};", b.set_f(fd), b.f(fs), b.f(ft));
+    case Instruction::SubtractReal:
+        return Printer::format("{} = {} - {};", b.set_f(fd), b.f(fs), b.f(ft));
+    case Instruction::MultiplyReal:
+        return Printer::format("{} = {} * {};", b.set_f(fd), b.f(fs), b.f(ft));
+    case Instruction::DivideReal:
+        return Printer::format("{} = {} / {};", b.set_f(fd), b.f(fs), b.f(ft));
+    case Instruction::MoveReal:
+        return Printer::format("{} = {};", b.set_f(fd), b.f(fs));
+    case Instruction::ConvertIntegerToReal:
+        return Printer::format("{} = (double)bits_of({});", b.set_f(fd), b.f(fs));
+    case Instruction::ConvertRealToInteger:
+        return Printer::format("{} = real_of((uint64_t){});", b.set_f(fd), b.f(fs));
+    case Instruction::SetFpFlagIfLessThan:
+        return Printer::format("{} = {} < {};", b.set_fp(), b.f(fs), b.f(ft));
+    case Instruction::SetFpFlagIfLessThanOrEqual:
+        return Printer::format("{} = {} <= {};", b.set_fp(), b.f(fs), b.f(ft));
+    case Instruction::SetFpFlagIfEqual:
+        return Printer::format("{} = {} == {};", b.set_fp(), b.f(fs), b.f(ft));
+    case Instruction::BranchIfFpFlagNotSet: {
+        int16_t w = i_w;
+        w *= 4;
+        return Printer::format("if (!{}) {}", b.fp(), move_pc(w));
+    }
+    case Instruction::BranchIfFpFlagSet: {
+        int16_t w = i_w;
+        w *= 4;
+        return Printer::format("if ({}) {}", b.fp(), move_pc(w));
+    }
+    case Instruction::MoveDataFromIntegerToFp:
+        return Printer::format("{} = (double){};", b.set_f(r_rd), b.r(i_rt));
+    case Instruction::MoveDataFromFpToInteger:
+        return Printer::format("{} = (uint64_t){};", b.set_r(i_rt), b.f(r_rd));
+    default:
+        // not an encoding of any instruction, the interpreter skips it too
+        return String{};
+    }
+}
+
+DiscardResult<FileError> translate_program(const InstructionData& program, const Path& source) {
+    OutputFile out{};
+    TRY(out.open(source));
+    out.write("// Generated by MIPSMulator --aot, one function per basic block of the program. Don't edit.\n"_sv);
+    out.write(Printer::format("#define DIRTY_LINE_SIZE {}\n", CPU::dirty_line_size).view());
+    out.write(prelude);
+    const auto& code = program.instructions;
+    // the block each instruction is in, by the index of its first instruction
+    Vector<size_t> block_of{};
+    block_of.resize(code.size());
+    for (size_t start = 0; start < code.size();) {
+        size_t end = start;
+        while (end < code.size() && !ends_block(code[end].id)) ++end;
+        if (end < code.size()) ++end;
+        BlockWriter block{};
+        String body{};
+        for (size_t i = start; i < end; ++i) {
+            block_of[i] = start;
+            String statement = translate_instruction(block, code[i]);
+            body += Printer::format("    case {}:\n", i - start);
+            if (!statement.is_empty()) body += "        "_s + statement + "\n"_s;
+            body += "        pc += 4;\n"_s;
+            if (i + 1 < end) body += "        [[fallthrough]];\n"_s;
+        }
+        block.append(body);
+        block.write(out, start, end - start);
+        start = end;
+    }
+    out.write(Printer::format("static const BlockEntry blocks[{}] = ", code.size() == 0 ? 1 : code.size()).view());
+    out.write("{\n"_sv);
+    for (size_t i = 0; i < code.size(); ++i) {
+        const size_t start = block_of[i];
+        size_t end = i + 1;
+        while (end < code.size() && block_of[end] == start) ++end;
+        out.write("    {"_sv);
+        out.write(Printer::format("block_{}, {}, {}", start, i - start, end - i).view());
+        out.write("},\n"_sv);
+    }
+    if (code.size() == 0) out.write("    {0, 0, 0},\n"_sv);
+    out.write("};\n\n"_sv);
+    out.write(
+        Printer::format("ASQ_EXPORT uint64_t asq_abi_version() {{ return {}ull; }}\n", native_abi_version).view());
+    const uint64_t hash = code_hash(code.data(), code.size());
+    out.write(Printer::format("ASQ_EXPORT uint64_t asq_code_hash() {{ return {}ull; }}\n", hash).view());
+    out.write(Printer::format("ASQ_EXPORT uint64_t asq_code_size() {{ return {}ull; }}\n", code.size()).view());
+    // the same checks in the same order as CPU::run_for(), the host turns SoftLimit into a cycle or time limit
+    out.write(Printer::format(R"(
+ASQ_EXPORT uint32_t asq_run(NativeState* s, uint64_t step_limit, uint64_t soft_limit) {{
+    for (;;) {{
+        if (s->halted) return {};
+        if (s->steps >= step_limit) return {};
+        const uint64_t index = s->pc / 4;
+        if (index >= {}ull) return {};
+        if (s->steps >= soft_limit) return {};
+        const BlockEntry* entry = &blocks[index];
+        if (entry->remaining > step_limit - s->steps) return {};
+        entry->run(s, entry->offset);
+    }}
+}}
+)",
+                              ToUnderlying(NativeStop::Halted), ToUnderlying(NativeStop::Budget), code.size(),
+                              ToUnderlying(NativeStop::PcOutOfRange), ToUnderlying(NativeStop::SoftLimit),
+                              ToUnderlying(NativeStop::Budget))
+                  .view());
+    return out.close();
+}
+
+#ifdef _WIN32
+// One argument of a command line, quoted so that CommandLineToArgvW and the C runtime give it back unchanged
+static String quote_argument(const String& arg) {
+    bool plain = !arg.is_empty();
+    for (char c : arg.view()) plain = plain && c != ' ' && c != '\t' && c != '"';
+    if (plain) return arg;
+    String quoted{"\""};
+    size_t backslashes = 0;
+    for (char c : arg.view()) {
+        if (c == '\\') {
+            ++backslashes;
+            continue;
+        }
+        // backslashes are only special in front of a quote, which gets one more of them
+        if (c == '"') backslashes = backslashes * 2 + 1;
+        for (; backslashes > 0; --backslashes) quoted.append('\\');
+        quoted.append(c);
+    }
+    for (backslashes *= 2; backslashes > 0; --backslashes) quoted.append('\\');
+    quoted.append('"');
+    return quoted;
+}
+#endif
+
+// Runs args[0] with the arguments as they are, no shell gets to interpret them. True if it exited with 0.
+static bool run_process(const Vector<String>& args) {
+#ifdef _WIN32
+    String command_line{};
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (i > 0) command_line.append(' ');
+        command_line += quote_argument(args[i]);
+    }
+    STARTUPINFOA startup{};
+    startup.cb = sizeof(startup);
+    PROCESS_INFORMATION process{};
+    if (!CreateProcessA(nullptr, command_line.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup,
+                        &process))
+        return false;
+    WaitForSingleObject(process.hProcess, INFINITE);
+    DWORD exit_code = 1;
+    GetExitCodeProcess(process.hProcess, &exit_code);
+    CloseHandle(process.hThread);
+    CloseHandle(process.hProcess);
+    return exit_code == 0;
+#else
+    Vector<char*> argv{};
+    for (const auto& arg : args) argv.append(const_cast<char*>(arg.data()));
+    argv.append(nullptr);
+    pid_t pid = 0;
+    if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0) return false;
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+}
+
+// cl and clang-cl take MSVC's options, every other compiler the ones of gcc and clang
+static bool takes_msvc_options(StringView compiler) {
+    size_t name_begin = 0;
+    for (size_t i = 0; i < compiler.size(); ++i) {
+        if (compiler[i] == '/' || compiler[i] == '\\') name_begin = i + 1;
+    }
+    String name{};
+    for (size_t i = name_begin; i < compiler.size(); ++i) {
+        const char c = compiler[i];
+        name.append(c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c);
+    }
+    return name == "cl"_sv || name == "cl.exe"_sv || name == "clang-cl"_sv || name == "clang-cl.exe"_sv;
+}
+
+DiscardResult<FileError> build_native(StringView source, StringView library, StringView compiler) {
+    String cxx{compiler};
+    if (cxx.is_empty()) {
+        const char* from_env = getenv("CXX");
+        if (from_env != nullptr) cxx = String{from_env};
+    }
+#ifdef _WIN32
+    if (cxx.is_empty()) cxx = "cl"_s;
+#else
+    if (cxx.is_empty()) cxx = "c++"_s;
+#endif
+    Vector<String> args{};
+    args.append(cxx);
+    if (takes_msvc_options(cxx.view())) {
+        args.append("/nologo"_s);
+        args.append("/O2"_s);
+        args.append("/LD"_s);
+        args.append(String{source});
+        args.append("/Fe"_s + String{library});
+    } else {
+        args.append("-std=c++17"_s);
+        args.append("-O2"_s);
+        args.append("-shared"_s);
+        args.append("-fPIC"_s);
+        args.append("-o"_s);
+        args.append(String{library});
+        args.append(String{source});
+    }
+    if (!run_process(args)) return FileError{Printer::format("{} failed on the translated program", cxx)};
+    return {};
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+#include "NativeProgram.h"
+#include <Path.hpp>
+
+using namespace ARLib;
+
+// hash of the encoded words a translated program was made from
+uint64_t code_hash(const DecodedInstruction* code, size_t count);
+// Writes C++ source with one function per basic block of the program and an exported asq_run() that dispatches
+// between them, the handlers of Execute.h turned into expressions on the decoded fields.
+DiscardResult<FileError> translate_program(const InstructionData& program, const Path& source);
+// Compiles translated source into a shared object. The compiler is started directly, without a shell, and is the
+// one given, else $CXX, else the system's c++ (cl on Windows).
+DiscardResult<FileError> build_native(StringView source, StringView library, StringView compiler);
\ No newline at end of file
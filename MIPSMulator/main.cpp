@@ -1,6 +1,10 @@
 #include "CPU.h"
 #include "DataParser.h"
+#include "EmulatorServer.h"
 #include "InstructionParser.h"
+#include "NativeProgram.h"
+#include "ThreadPool.h"
+#include "Translator.h"
 #include <ArgParser.hpp>
 #include <Printer.hpp>
 
@@ -8,15 +12,70 @@
 #define EXIT_SUCCESS 0
 
 using namespace ARLib;
+
 int main(int argc, char** argv) {
-    bool print_instructions = false;
+    RunOptions run_options{};
+    bool send_paths = false;
+    bool stop = false;
     String rodata_file;
     String code_file;
+    String jobs;
+    String max_steps;
+    String max_cycles;
+    String time_limit;
+    String memdump;
+    String aot_library;
+    String native_library;
+    String compiler;
+    String serve_socket;
+    String connect_socket;
     ArgParser parser{argc, argv};
     parser.add_version(1, 0);
     parser.add_option("--rodata", "filename", "ROData file to read", rodata_file);
     parser.add_option("--code", "filename", "Code file to read", code_file);
-    parser.add_option("--insn", "Print the instructions as they're being executed", print_instructions);
+    parser.add_option("--insn", "Print the instructions as they're being executed", run_options.trace);
+    parser.add_option("--checked", "Stop the program on a load or store outside the memory",
+                      run_options.checked_memory);
+    parser.add_option("--stats", "Print the cycle count and how many times every instruction was executed",
+                      run_options.stats);
+    parser.add_option("--latency",
+                      "Count multiplies, divides and floating point operations as multi-cycle instructions",
+                      run_options.latency_timing);
+    parser.add_option("--fast-forward",
+                      "Skip over the iterations of counted loops on integer registers, with the same results, clock "
+                      "count and statistics as running them. dump.txt leaves out the skipped steps",
+                      run_options.fast_forward);
+    parser.add_option("--memdump", "format",
+                      "How to dump the memory once the program stops: full (default) or modified to memdump.dat, "
+                      "diff for only the modified lines to memdump.diff",
+                      memdump);
+    parser.add_option("--aot", "library",
+                      "Translate the code file into library.cpp, compile it into the library and exit, the library "
+                      "runs the program with --native",
+                      aot_library);
+    parser.add_option("--cxx", "compiler", "With --aot, the compiler to build the library with (default: $CXX, or c++)",
+                      compiler);
+    parser.add_option("--native", "library",
+                      "Run the program translated into the library by --aot, without writing dump.txt",
+                      native_library);
+    parser.add_option("--serve", "socket",
+                      "Run as a server running the programs sent to the socket, paths are relative to the server's "
+                      "working directory",
+                      serve_socket);
+    parser.add_option("--jobs", "count", "With --serve, number of programs to run at once (default: one per core)",
+                      jobs);
+    parser.add_option("--connect", "socket", "Have the server listening on the socket run the program",
+                      connect_socket);
+    parser.add_option("--send-path", "With --connect, let the server read the files instead of sending them",
+                      send_paths);
+    parser.add_option("--max-steps", "count",
+                      "Stop the program after this many instructions (default: no limit, 100000000 with --connect)",
+                      max_steps);
+    parser.add_option("--max-cycles", "count", "Stop the program after this many cycles (default: no limit)",
+                      max_cycles);
+    parser.add_option("--time-limit", "ms", "Stop the program after this many milliseconds (default: no limit)",
+                      time_limit);
+    parser.add_option("--stop-server", "With --connect, ask the server to stop", stop);
     auto ec = parser.parse();
     if (ec.is_error()) {
         Printer::print("Error parsing arguments: {}", ec.to_error().error_string());
@@ -26,6 +85,49 @@ int main(int argc, char** argv) {
         parser.print_help();
         return EXIT_SUCCESS;
     }
+    if (!serve_socket.is_empty()) {
+        size_t thread_count = 0;
+        if (!jobs.is_empty()) {
+            auto count_or_err = StrViewToUInt(jobs.view());
+            if (count_or_err.is_error()) {
+                Printer::print("Invalid thread count {}", jobs);
+                return EXIT_FAILURE;
+            }
+            thread_count = count_or_err.to_ok();
+        }
+        ThreadPool pool{thread_count};
+        EmulatorServer server{pool};
+        if (auto res = server.listen(serve_socket.view()); res.is_error()) {
+            Printer::print("Error listening on {}: {}", serve_socket, res.to_error());
+            return EXIT_FAILURE;
+        }
+        server.serve();
+        return EXIT_SUCCESS;
+    }
+    if (!connect_socket.is_empty() && stop) {
+        return stop_emulator_server(connect_socket.view()) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (!aot_library.is_empty()) {
+        if (code_file.is_empty()) {
+            Printer::print("No code file specified");
+            return EXIT_FAILURE;
+        }
+        InstructionData program{};
+        if (auto res = program.load(code_file); res.is_error()) {
+            Printer::print("Error reading the code: {}", res.to_error());
+            return EXIT_FAILURE;
+        }
+        const String source = aot_library + ".cpp"_s;
+        if (auto res = translate_program(program, source); res.is_error()) {
+            Printer::print("Error writing {}: {}", source, res.to_error());
+            return EXIT_FAILURE;
+        }
+        if (auto res = build_native(source.view(), aot_library.view(), compiler.view()); res.is_error()) {
+            Printer::print("Error building {}: {}", aot_library, res.to_error());
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
     if (rodata_file.is_empty()) {
         Printer::print("No rodata file specified");
         return EXIT_FAILURE;
@@ -34,11 +136,61 @@ int main(int argc, char** argv) {
         Printer::print("No code file specified");
         return EXIT_FAILURE;
     }
-    CPU cpu{};
+    if (!connect_socket.is_empty()) {
+        EmulatorClientOptions options{send_paths};
+        if (!parse_count(max_steps, "instruction count"_sv, options.max_steps) ||
+            !parse_count(max_cycles, "cycle count"_sv, options.max_cycles) ||
+            !parse_count(time_limit, "time limit"_sv, options.time_limit_ms))
+            return EXIT_FAILURE;
+        return emulate_remotely(connect_socket.view(), code_file, rodata_file, options);
+    }
+    MemoryDumpFormat dump_format = MemoryDumpFormat::Full;
+    if (memdump == "modified"_sv) {
+        dump_format = MemoryDumpFormat::Modified;
+    } else if (memdump == "diff"_sv) {
+        dump_format = MemoryDumpFormat::BinaryDiff;
+    } else if (!memdump.is_empty() && memdump != "full"_sv) {
+        Printer::print("Invalid memory dump format {}", memdump);
+        return EXIT_FAILURE;
+    }
+    RunLimits limits{};
+    if (!parse_count(max_steps, "instruction count"_sv, limits.max_steps) ||
+        !parse_count(max_cycles, "cycle count"_sv, limits.max_cycles) ||
+        !parse_count(time_limit, "time limit"_sv, limits.time_limit_ms))
+        return EXIT_FAILURE;
+    if (!native_library.is_empty() && (run_options.trace || run_options.checked_memory || run_options.stats ||
+                                       run_options.latency_timing || run_options.fast_forward)) {
+        Printer::print("--native runs without --insn, --checked, --stats, --latency and --fast-forward");
+        return EXIT_FAILURE;
+    }
+    if (run_options.trace && run_options.fast_forward) {
+        Printer::print("--fast-forward skips the instructions --insn would print");
+        return EXIT_FAILURE;
+    }
+    CPU cpu{true};
     if (auto m_err = cpu.initialize(code_file, rodata_file); m_err.is_error()) {
         Printer::print("Error initializing CPU: {}", m_err.to_error());
         return EXIT_FAILURE;
     };
-    cpu.run(print_instructions);
-    return EXIT_SUCCESS;
+    if (!native_library.is_empty()) {
+        NativeProgram native{};
+        if (auto res = native.load(native_library.view()); res.is_error()) {
+            Printer::print("Error loading {}: {}", native_library, res.to_error());
+            return EXIT_FAILURE;
+        }
+        if (!native.matches(cpu)) {
+            Printer::print("{} wasn't translated from {}", native_library, code_file);
+            return EXIT_FAILURE;
+        }
+        const StopReason reason = native.run(cpu, limits);
+        cpu.dump_memory(dump_format);
+        if (reason != StopReason::Halted) CPU::print_result(reason, cpu.state(), cpu.memory_digest());
+        return exit_status(reason);
+    }
+    // the only runtime decision about the policy, the run itself has no checks it didn't ask for
+    const StopReason reason =
+        with_run_policy(run_options, [&](auto policy) { return cpu.run<decltype(policy)>(limits, dump_format); });
+    if (run_options.stats) cpu.print_stats(reason);
+    if (reason != StopReason::Halted) CPU::print_result(reason, cpu.state(), cpu.memory_digest());
+    return exit_status(reason);
 }
\ No newline at end of file